@@ -0,0 +1,91 @@
+// Cost of one enabled LOG() / LOGF() on the calling thread.
+//
+//   immediate   formats on the caller and hands the line to spdlog (null sink)
+//   deferred    copies the raw arguments into the thread's ring (LogConfig::deferred)
+//
+// The deferred runs drain the ring outside the timed region every kBatch calls, so the
+// numbers are the hot-path cost, not the background formatter's throughput.
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <spdlog/sinks/null_sink.h>
+#include "slog.h"
+
+namespace {
+
+using cpptools::slog::LogConfig;
+using cpptools::slog::LogSeverity;
+using cpptools::slog::LogWrapper;
+
+constexpr int kBatch = 16384;
+
+void install(bool deferred) {
+    LogConfig cfg;
+    cfg.log_level          = LogSeverity::INFO;
+    cfg.deferred           = deferred;
+    cfg.deferred_ring_size = 8 << 20;
+    std::vector<spdlog::sink_ptr> sinks{std::make_shared<spdlog::sinks::null_sink_mt>()};
+    auto                          lw = std::make_shared<LogWrapper>(cfg, sinks.begin(), sinks.end());
+    lw->logger_->set_level(spdlog::level::info);
+    cpptools::slog::SetLogWrapper(lw);
+}
+
+template <class Log>
+void run(benchmark::State& state, bool deferred, Log log) {
+    install(deferred);
+    auto& lw = cpptools::slog::getLogWrapper();
+    int   n  = 0;
+    for (auto _ : state) {
+        log(n);
+        if (++n % kBatch == 0) {
+            state.PauseTiming();
+            lw->drain();
+            state.ResumeTiming();
+        }
+    }
+    lw->drain();
+    state.SetItemsProcessed(state.iterations());
+    state.counters["dropped"] = double(cpptools::slog::GetLogStats().dropped);
+}
+
+void register_all() {
+    for (bool deferred : {false, true}) {
+        std::string mode = deferred ? "deferred" : "immediate";
+        benchmark::RegisterBenchmark(("LOG_int/" + mode).c_str(), [deferred](benchmark::State& st) {
+            run(st, deferred, [](int i) { LOG(INFO) << "request " << i << " done"; });
+        });
+        benchmark::RegisterBenchmark(("LOG_mixed/" + mode).c_str(), [deferred](benchmark::State& st) {
+            std::string_view peer = "10.0.0.1:443";
+            run(st, deferred, [peer](int i) {
+                LOG(INFO) << "conn " << i << " peer=" << peer << " rtt=" << 1.25 << " ok=" << true;
+            });
+        });
+        benchmark::RegisterBenchmark(("LOGF_mixed/" + mode).c_str(), [deferred](benchmark::State& st) {
+            std::string_view peer = "10.0.0.1:443";
+            run(st, deferred, [peer](int i) { LOGF(INFO, "conn {} peer={} rtt={:.2f} ok={}", i, peer, 1.25, true); });
+        });
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    // JSON unless the caller picked a format
+    std::vector<char*> args(argv, argv + argc);
+    bool               has_format = false;
+    for (int i = 1; i < argc; ++i) has_format |= std::string_view(argv[i]).starts_with("--benchmark_format");
+    std::string json = "--benchmark_format=json";
+    if (!has_format) args.push_back(json.data());
+
+    int n = int(args.size());
+    benchmark::Initialize(&n, args.data());
+    if (benchmark::ReportUnrecognizedArguments(n, args.data())) return 1;
+    register_all();
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
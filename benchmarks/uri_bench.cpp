@@ -0,0 +1,130 @@
+// Throughput of the URI parsers on representative inputs.
+//
+// Every benchmark parses a fixed set of inputs per iteration and reports
+//   ns/URI       wall time per parsed URI
+//   allocs/URI   global operator new calls per parsed URI
+// Output defaults to JSON so runs can be diffed, e.g. with Google Benchmark's
+// tools/compare.py:
+//   ./uri_bench --benchmark_out=before.json
+//   ./uri_bench --benchmark_out=after.json
+//   compare.py benchmarks before.json after.json
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include "uri.h"
+
+namespace {
+
+std::atomic<uint64_t> g_allocs{0};
+
+}  // namespace
+
+void* operator new(size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+using cpptools::net::parse_mode;
+using cpptools::net::URI;
+using cpptools::net::URIView;
+
+std::vector<std::string> short_inputs() {
+    return {"http://example.com/", "https://a.b/c", "redis://cache:6379", "mailto:someone@example.org",
+            "ftp://user:pw@files.example.net/pub/x.tar.gz"};
+}
+
+std::vector<std::string> long_query_inputs() {
+    std::string q;
+    for (int i = 0; i < 64; ++i) q += (i ? "&" : "") + std::string("param") + std::to_string(i) + "=value" + std::to_string(i);
+    return {"https://api.example.com/v1/search?" + q, "http://h/x?" + q + "#frag"};
+}
+
+std::vector<std::string> multi_host_inputs() {
+    return {"mongodb://user:pw@db1.example.com:27017,db2.example.com:27017,db3.example.com:27017/app?replicaSet=rs0",
+            "etcd://10.0.0.1:2379,10.0.0.2:2379,10.0.0.3:2379,10.0.0.4:2379,10.0.0.5:2379",
+            "redis-sentinel://s1:26379,s2:26379,s3:26379/mymaster"};
+}
+
+std::vector<std::string> ipv6_inputs() {
+    return {"http://[2001:db8::1]:8080/index.html", "mongodb://[::1]:27017,[fe80::1%25eth0]:27018/db",
+            "https://[2001:db8:85a3:8d3:1319:8a2e:370:7348]/", "tcp://[::ffff:192.0.2.128]:443"};
+}
+
+std::vector<std::string> percent_inputs() {
+    return {"http://h/%E4%BD%A0%E5%A5%BD/%E4%B8%96%E7%95%8C?q=%E6%90%9C%E7%B4%A2&x=%20%21%40%23%24",
+            "http://us%65r:p%40ss@%45xample.com/a%2Fb%2Fc/%7Efile?%61=%62#%66rag",
+            "s3://bucket/key%20with%20spaces%20and%20more%20spaces%20and%20yet%20more"};
+}
+
+// run `parse` over every input per iteration and report per-URI counters
+template <class Parse>
+void run(benchmark::State& state, const std::vector<std::string>& inputs, Parse parse) {
+    uint64_t allocs = 0, parsed = 0;
+    auto     start  = std::chrono::steady_clock::now();
+    for (auto _ : state) {
+        uint64_t before = g_allocs.load(std::memory_order_relaxed);
+        for (const auto& in : inputs) parse(in);
+        allocs += g_allocs.load(std::memory_order_relaxed) - before;
+        parsed += inputs.size();
+    }
+    auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    state.SetItemsProcessed(int64_t(parsed));
+    state.counters["ns/URI"]     = parsed ? ns / double(parsed) : 0;
+    state.counters["allocs/URI"] = parsed ? double(allocs) / double(parsed) : 0;
+}
+
+void register_all() {
+    const std::pair<const char*, std::vector<std::string>> sets[] = {
+        {"short", short_inputs()},        {"long_query", long_query_inputs()}, {"multi_host", multi_host_inputs()},
+        {"ipv6", ipv6_inputs()},          {"percent", percent_inputs()},
+    };
+    for (const auto& [name, inputs] : sets) {
+        benchmark::RegisterBenchmark((std::string("URI/") + name).c_str(), [inputs](benchmark::State& st) {
+            run(st, inputs, [](const std::string& in) { benchmark::DoNotOptimize(URI(in)); });
+        });
+        benchmark::RegisterBenchmark((std::string("URIView/") + name).c_str(), [inputs](benchmark::State& st) {
+            run(st, inputs, [](const std::string& in) { benchmark::DoNotOptimize(URIView(in)); });
+        });
+        benchmark::RegisterBenchmark((std::string("URIView_strict/") + name).c_str(), [inputs](benchmark::State& st) {
+            run(st, inputs, [](const std::string& in) { benchmark::DoNotOptimize(URIView::try_parse(in, parse_mode::strict)); });
+        });
+        // walk the hosts too, which is where the view defers its work
+        benchmark::RegisterBenchmark((std::string("URIView_hosts/") + name).c_str(), [inputs](benchmark::State& st) {
+            run(st, inputs, [](const std::string& in) {
+                for (const auto& hp : URIView(in).hosts()) benchmark::DoNotOptimize(hp);
+            });
+        });
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    // JSON unless the caller picked a format
+    std::vector<char*> args(argv, argv + argc);
+    bool               has_format = false;
+    for (int i = 1; i < argc; ++i) has_format |= std::string_view(argv[i]).starts_with("--benchmark_format");
+    std::string json = "--benchmark_format=json";
+    if (!has_format) args.push_back(json.data());
+    // --benchmark_out files default to JSON already
+
+    int n = int(args.size());
+    benchmark::Initialize(&n, args.data());
+    if (benchmark::ReportUnrecognizedArguments(n, args.data())) return 1;
+    register_all();
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
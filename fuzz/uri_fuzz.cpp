@@ -0,0 +1,107 @@
+// Differential fuzz target: the owning URI and the non-owning URIView must agree on
+// every input, in both parse modes.
+//
+// With clang and BUILD_FUZZERS=ON this links against libFuzzer:
+//   ./uri_fuzz -max_len=512 corpus/uri
+// Otherwise the same checks are built with a small driver that replays the files
+// (or directories) named on the command line, which is how ctest runs the seed corpus.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+#include "uri.h"
+
+using cpptools::net::parse_mode;
+using cpptools::net::URI;
+using cpptools::net::URIView;
+
+namespace {
+
+#define FUZZ_CHECK(cond)                                                                      \
+    do {                                                                                      \
+        if (!(cond)) {                                                                        \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);   \
+            std::abort();                                                                     \
+        }                                                                                     \
+    } while (0)
+
+void check(std::string_view in, parse_mode mode) {
+    auto v = URIView::try_parse(in, mode);
+    auto u = URI::try_parse(in, mode);
+    FUZZ_CHECK(v.has_value() == u.has_value());
+    if (!v) {
+        FUZZ_CHECK(v.error() == u.error());
+        return;
+    }
+
+    FUZZ_CHECK(v->scheme() == u->scheme());
+    FUZZ_CHECK(v->userinfo().has_value() == u->User().has_value());
+    FUZZ_CHECK(v->raw_path() == u->raw_path());
+    FUZZ_CHECK(v->raw_query() == u->raw_query());
+    FUZZ_CHECK(v->fragment() == u->fragment());
+
+    // the owning hosts are the view's hosts, percent-decoded and lowercased
+    size_t i = 0;
+    for (const auto& hp : v->hosts()) {
+        FUZZ_CHECK(i < u->hosts().size());
+        const auto& owned = u->hosts()[i++];
+        std::string host  = URI::percent_decode(hp.host);
+        for (auto& c : host) c = cpptools::net::detail::to_lower(c);
+        FUZZ_CHECK(host == owned.host);
+        FUZZ_CHECK(hp.port == owned.port);
+        if (hp.ip) FUZZ_CHECK(hp.ip == owned.ip);
+    }
+    FUZZ_CHECK(i == u->hosts().size());
+
+    // both report the same normal form
+    FUZZ_CHECK(cpptools::net::normalize(*v) == u->normalized());
+    FUZZ_CHECK(cpptools::net::normalized_hash(*v) == u->hash());
+}
+
+}  // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    std::string_view in(reinterpret_cast<const char*>(data), size);
+    check(in, parse_mode::lenient);
+    check(in, parse_mode::strict);
+    return 0;
+}
+
+#ifndef CPPTOOLS_LIBFUZZER
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+static int replay(const std::filesystem::path& p) {
+    std::ifstream f(p, std::ios::binary);
+    if (!f) {
+        std::fprintf(stderr, "cannot read %s\n", p.c_str());
+        return 1;
+    }
+    std::string data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int failed = 0, runs = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::filesystem::path p(argv[i]);
+        if (std::filesystem::is_directory(p)) {
+            for (const auto& e : std::filesystem::directory_iterator(p)) {
+                if (!e.is_regular_file()) continue;
+                failed += replay(e.path());
+                ++runs;
+            }
+        } else {
+            failed += replay(p);
+            ++runs;
+        }
+    }
+    std::printf("replayed %d inputs\n", runs);
+    return failed || runs == 0;
+}
+#endif
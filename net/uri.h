@@ -11,300 +11,1836 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <bit>
 #include <cassert>
 #include <chrono>
 #include <cctype>
+#include <climits>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <exception>
 #include <iomanip>
 #include <initializer_list>
+#include <iterator>
 #include <optional>
+#include <span>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <vector>
 
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CPPTOOLS_URI_X86 1
+#endif
+
 namespace cpptools {
 namespace net {
 
+enum class uri_errc : uint8_t {
+    ok = 0,
+    empty_input,
+    input_too_long,
+    missing_scheme,
+    empty_scheme,
+    invalid_scheme_char,
+    unclosed_ipv6_bracket,
+    bad_ipv6_suffix,  // unexpected chars after ']'
+    empty_port,
+    port_leading_zero,
+    port_not_digit,
+    port_out_of_range,
+    too_many_hosts,
+    invalid_char,          // strict mode: byte not allowed in the current component
+    bad_percent_encoding,  // strict mode: '%' not followed by two hex digits
+    bad_host,              // strict mode: empty or malformed host item
+};
+
+constexpr const char* to_string(uri_errc e) {
+    switch (e) {
+        case uri_errc::ok: return "ok";
+        case uri_errc::empty_input: return "empty input";
+        case uri_errc::input_too_long: return "input too long";
+        case uri_errc::missing_scheme: return "missing scheme";
+        case uri_errc::empty_scheme: return "empty scheme";
+        case uri_errc::invalid_scheme_char: return "invalid scheme char";
+        case uri_errc::unclosed_ipv6_bracket: return "unclosed IPv6 bracket";
+        case uri_errc::bad_ipv6_suffix: return "unexpected chars after IPv6 literal";
+        case uri_errc::empty_port: return "empty port";
+        case uri_errc::port_leading_zero: return "port has leading zeros";
+        case uri_errc::port_not_digit: return "port contains non-digit";
+        case uri_errc::port_out_of_range: return "port out of range";
+        case uri_errc::too_many_hosts: return "too many hosts";
+        case uri_errc::invalid_char: return "invalid character";
+        case uri_errc::bad_percent_encoding: return "malformed percent-encoding";
+        case uri_errc::bad_host: return "malformed host";
+    }
+    return "unknown error";
+}
+
+// Error code plus the byte offset in the input where parsing stopped.
+struct uri_error {
+    uri_errc code   = uri_errc::ok;
+    uint32_t offset = 0;
+
+    constexpr explicit operator bool() const { return code != uri_errc::ok; }
+    constexpr const char* message() const { return to_string(code); }
+    bool        operator==(const uri_error& o) const = default;
+};
+
+// lenient: historical behaviour, only scheme and ports are validated.
+// strict:  RFC 3986 character sets, percent triplets and host items are validated too.
+enum class parse_mode : uint8_t { lenient, strict };
+
 struct parse_error : public std::runtime_error {
     explicit parse_error(const std::string& s) : std::runtime_error(s) {}
+    explicit parse_error(uri_error e)
+        : std::runtime_error(std::string(e.message()) + " at offset " + std::to_string(e.offset)), error_(e) {}
+
+    uri_errc code() const { return error_.code; }
+    size_t   offset() const { return error_.offset; }
+
+   private:
+    uri_error error_;
+};
+
+// Either a parsed value or a uri_error; the subset of std::expected (C++23) used here.
+template <typename T>
+class parse_result {
+   public:
+    constexpr parse_result(T v) : value_(std::move(v)) {}
+    constexpr parse_result(uri_error e) : error_(e) {}
+
+    constexpr bool     has_value() const { return value_.has_value(); }
+    constexpr explicit operator bool() const { return has_value(); }
+
+    // throws parse_error when holding an error
+    constexpr T& value() & {
+        if (!value_) throw parse_error(error_);
+        return *value_;
+    }
+    constexpr const T& value() const& {
+        if (!value_) throw parse_error(error_);
+        return *value_;
+    }
+    constexpr T&& value() && {
+        if (!value_) throw parse_error(error_);
+        return std::move(*value_);
+    }
+    constexpr T&        operator*() & { return *value_; }
+    constexpr const T&  operator*() const& { return *value_; }
+    constexpr T*        operator->() { return &*value_; }
+    constexpr const T*  operator->() const { return &*value_; }
+    constexpr uri_error error() const { return error_; }
+
+   private:
+    std::optional<T> value_;
+    uri_error        error_;
+};
+
+// Binary form of an IP literal host, filled while the host list is split. `family` is
+// none for reg-names (resolve those with getaddrinfo).
+struct IPAddr {
+    enum Family : uint8_t { none = 0, v4 = 4, v6 = 6 };
+
+    Family                  family   = none;
+    bool                    has_zone = false;  // IPv6 zone id present (RFC 6874)
+    uint32_t                scope_id = 0;      // numeric zone id; named zones are resolved by sockaddr()
+    std::array<uint8_t, 16> bytes{};           // network byte order, IPv4 uses the first 4
+
+    constexpr explicit operator bool() const { return family != none; }
+    constexpr bool     is_v4() const { return family == v4; }
+    constexpr bool     is_v6() const { return family == v6; }
+    constexpr bool     operator==(const IPAddr& o) const = default;
 };
 
+// Ready-to-connect socket address
+struct SockAddr {
+    sockaddr_storage storage{};
+    socklen_t        len = 0;
+
+    const sockaddr* addr() const { return reinterpret_cast<const sockaddr*>(&storage); }
+    int             family() const { return storage.ss_family; }
+};
+
+namespace detail {
+
+// `zone` is the text after the zone delimiter; names are looked up with if_nametoindex
+inline std::optional<SockAddr> make_sockaddr(const IPAddr& ip, uint16_t port, std::string_view zone) {
+    SockAddr sa;
+    if (ip.is_v4()) {
+        auto* in       = reinterpret_cast<sockaddr_in*>(&sa.storage);
+        in->sin_family = AF_INET;
+        in->sin_port   = htons(port);
+        std::memcpy(&in->sin_addr, ip.bytes.data(), 4);
+        sa.len = sizeof(sockaddr_in);
+        return sa;
+    }
+    if (ip.is_v6()) {
+        auto* in6        = reinterpret_cast<sockaddr_in6*>(&sa.storage);
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port   = htons(port);
+        std::memcpy(&in6->sin6_addr, ip.bytes.data(), 16);
+        in6->sin6_scope_id = ip.scope_id;
+        if (ip.has_zone && ip.scope_id == 0) {
+            std::string name(zone);
+            in6->sin6_scope_id = if_nametoindex(name.c_str());
+            if (in6->sin6_scope_id == 0) return std::nullopt;
+        }
+        sa.len = sizeof(sockaddr_in6);
+        return sa;
+    }
+    return std::nullopt;
+}
+
+// text after the zone delimiter of an IPv6 host: "%25" in raw URIs, '%' once decoded
+constexpr std::string_view zone_of(std::string_view host, bool raw) {
+    size_t pct = host.find('%');
+    if (pct == std::string_view::npos) return {};
+    auto zone = host.substr(pct + 1);
+    if (raw && zone.starts_with("25")) zone.remove_prefix(2);
+    return zone;
+}
+
+}  // namespace detail
+
 struct HostPort {
     std::string             host;  // for IPv6 this does not include surrounding brackets
     std::optional<uint16_t> port;
+    IPAddr                  ip;  // binary address when host is an IP literal
     bool                    operator==(const HostPort& o) const { return host == o.host && port == o.port; }
     std::string             to_string() const {
-        bool        is_ipv6 = host.find(':') != std::string::npos;
         std::string inst;
-        if (is_ipv6)
-            inst += '[' + host + ']';
-        else
-            inst += host;
-        if (port) inst += ':' + std::to_string(*port);
+        append_to(inst);
         return inst;
     }
+    // host[:port], IPv6 bracketed, appended to `out`
+    void append_to(std::string& out) const {
+        bool is_ipv6 = ip.is_v6() || (!ip && host.find(':') != std::string::npos);
+        if (is_ipv6) out.push_back('[');
+        out.append(host);
+        if (is_ipv6) out.push_back(']');
+        if (port) {
+            out.push_back(':');
+            out.append(std::to_string(*port));
+        }
+    }
+    // socket address for IP literals without re-parsing; nullopt for reg-names
+    std::optional<SockAddr> sockaddr(uint16_t default_port = 0) const {
+        return detail::make_sockaddr(ip, port.value_or(default_port), detail::zone_of(host, false));
+    }
 };
 
-class URI final {
-   private:
-    std::string                uri_;
-    std::string                scheme_;
-    std::optional<std::string> authority_;
-    std::vector<HostPort>      hosts_;
-    std::string                path_;
-    std::optional<std::string> query_;
-    std::optional<std::string> fragment_;
-    bool                       has_authority_ = false;
+// Non-owning counterpart of HostPort. `host` points into the parsed input and is
+// neither percent-decoded nor lowercased.
+struct HostPortView {
+    std::string_view        host;  // for IPv6 this does not include surrounding brackets
+    std::optional<uint16_t> port;
+    IPAddr                  ip;  // binary address when host is an IP literal
+    // `ip` is derived from `host`, so it does not take part in comparisons
+    constexpr bool operator==(const HostPortView& o) const { return host == o.host && port == o.port; }
+    std::optional<SockAddr> sockaddr(uint16_t default_port = 0) const {
+        return detail::make_sockaddr(ip, port.value_or(default_port), detail::zone_of(host, true));
+    }
+};
+
+namespace detail {
+
+// [pos, pos + len) inside the parsed input
+struct span {
+    uint32_t         pos = 0;
+    uint32_t         len = 0;
+    constexpr std::string_view in(std::string_view s) const { return s.substr(pos, len); }
+    static constexpr span      of(size_t b, size_t e) { return span{uint32_t(b), uint32_t(e - b)}; }
+};
+
+// Offsets of every component of a parsed URI. Trivially copyable, so it stays
+// valid when the buffer it describes is moved (e.g. a short std::string).
+struct uri_layout {
+    span     scheme;
+    span     userinfo;  // before the last '@' of the authority
+    span     hostlist;  // comma separated host[:port] items
+    span     path;
+    span     query;
+    span     fragment;
+    uint16_t host_count    = 0;
+    bool     has_authority = false;
+    bool     has_userinfo  = false;
+    bool     has_query     = false;
+    bool     has_fragment  = false;
+};
+
+// Byte classes shared by the lenient helpers and the strict DFA. Locale independent.
+enum cclass : uint8_t {
+    C_ILLEGAL,
+    C_HEXALPHA,    // a-f A-F
+    C_ALPHA,       // other letters
+    C_DIGIT,       // 0-9
+    C_DASHDOT,     // - .
+    C_UNDERTILDE,  // _ ~
+    C_PLUS,        // +
+    C_SUBDELIM,    // ! $ & ' ( ) * ; =
+    C_COMMA,
+    C_COLON,
+    C_SLASH,
+    C_QUESTION,
+    C_HASH,
+    C_AT,
+    C_LBRACKET,
+    C_RBRACKET,
+    C_PERCENT,
+    C_SPACE,  // illegal everywhere, but trimmed around host items
+    C_COUNT
+};
+
+inline constexpr std::array<uint8_t, 256> kCharClass = [] {
+    std::array<uint8_t, 256> t{};
+    for (int c = 'a'; c <= 'z'; ++c) t[c] = t[c - 'a' + 'A'] = c <= 'f' ? C_HEXALPHA : C_ALPHA;
+    for (int c = '0'; c <= '9'; ++c) t[c] = C_DIGIT;
+    t['-'] = t['.'] = C_DASHDOT;
+    t['_'] = t['~'] = C_UNDERTILDE;
+    t['+']          = C_PLUS;
+    for (char c : std::string_view("!$&'()*;=")) t[(unsigned char)c] = C_SUBDELIM;
+    t[','] = C_COMMA;
+    t[':'] = C_COLON;
+    t['/'] = C_SLASH;
+    t['?'] = C_QUESTION;
+    t['#'] = C_HASH;
+    t['@'] = C_AT;
+    t['['] = C_LBRACKET;
+    t[']'] = C_RBRACKET;
+    t['%'] = C_PERCENT;
+    for (char c : std::string_view(" \t\n\v\f\r")) t[(unsigned char)c] = C_SPACE;
+    return t;
+}();
+
+constexpr cclass char_class(char c) { return cclass(kCharClass[(unsigned char)c]); }
+constexpr bool   is_space(char c) { return char_class(c) == C_SPACE; }
+constexpr bool   is_alpha(char c) { return char_class(c) == C_HEXALPHA || char_class(c) == C_ALPHA; }
+constexpr bool   is_digit(char c) { return char_class(c) == C_DIGIT; }
+constexpr char   to_lower(char c) { return c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c; }
+constexpr bool   is_scheme_char(char c, size_t pos) {
+    if (pos == 0) return is_alpha(c);
+    auto k = char_class(c);
+    return k == C_HEXALPHA || k == C_ALPHA || k == C_DIGIT || k == C_PLUS || k == C_DASHDOT;
+}
+
+constexpr std::string_view trim_space(std::string_view v) {
+    size_t b = 0;
+    while (b < v.size() && is_space(v[b])) ++b;
+    size_t e = v.size();
+    while (e > b && is_space(v[e - 1])) --e;
+    return v.substr(b, e - b);
+}
+
+// Structural scanning: one pass over the input marks every `:/?#@[],%` byte in a 64-bit
+// mask per 64-byte block; the parser then jumps between set bits instead of re-walking
+// the input byte by byte for each delimiter it looks for.
+inline constexpr char kStructural[] = {':', '/', '?', '#', '@', '[', ']', ',', '%'};
+
+// p must point to 64 readable bytes; bit k is set when p[k] is structural
+typedef uint64_t (*block_scanner)(const char* p);
+
+inline uint64_t scan_block_swar(const char* p) {
+    constexpr uint64_t lo7 = 0x7F7F7F7F7F7F7F7FULL;
+    uint64_t           mask = 0;
+    for (int w = 0; w < 8; ++w) {
+        uint64_t x;
+        std::memcpy(&x, p + w * 8, 8);
+        uint64_t hit = 0;
+        for (char c : kStructural) {
+            uint64_t t = x ^ (0x0101010101010101ULL * (unsigned char)c);
+            hit |= ~(((t & lo7) + lo7) | t | lo7);  // 0x80 in every byte where t == 0
+        }
+        // gather the high bit of each byte into 8 consecutive bits
+        mask |= (((hit >> 7) * 0x0102040810204080ULL) >> 56) << (w * 8);
+    }
+    return mask;
+}
+
+#ifdef CPPTOOLS_URI_X86
+__attribute__((target("sse2"))) inline uint64_t scan_block_sse2(const char* p) {
+    uint64_t mask = 0;
+    for (int w = 0; w < 4; ++w) {
+        __m128i v   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + w * 16));
+        __m128i hit = _mm_setzero_si128();
+        for (char c : kStructural) hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+        mask |= uint64_t(uint32_t(_mm_movemask_epi8(hit))) << (w * 16);
+    }
+    return mask;
+}
+
+__attribute__((target("avx2"))) inline uint64_t scan_block_avx2(const char* p) {
+    uint64_t mask = 0;
+    for (int w = 0; w < 2; ++w) {
+        __m256i v   = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + w * 32));
+        __m256i hit = _mm256_setzero_si256();
+        for (char c : kStructural) hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)));
+        mask |= uint64_t(uint32_t(_mm256_movemask_epi8(hit))) << (w * 32);
+    }
+    return mask;
+}
+#endif
+
+// best backend for the running CPU, resolved once
+inline block_scanner active_scanner() {
+    static const block_scanner fn = [] {
+#ifdef CPPTOOLS_URI_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return &scan_block_avx2;
+        if (__builtin_cpu_supports("sse2")) return &scan_block_sse2;
+#endif
+        return &scan_block_swar;
+    }();
+    return fn;
+}
 
+// Walks the structural positions of `s` in order, scanning each 64-byte block once.
+// During constant evaluation it falls back to a plain byte loop.
+class structural_cursor {
    public:
-    const std::string& uri() const { return uri_; }
-    const std::string& scheme() const { return scheme_; }
+    constexpr explicit structural_cursor(std::string_view s) : s_(s) {
+        if (!std::is_constant_evaluated()) scan_ = active_scanner();
+    }
+    structural_cursor(std::string_view s, block_scanner scan) : s_(s), scan_(scan) {}
 
-    typedef std::pair<std::string, std::string> UserPass;
-    std::optional<UserPass>                     User() const {
-        if (!authority_) return std::nullopt;
-        const auto& a   = *authority_;
-        size_t      pos = a.find(':');
-        if (pos == std::string::npos) return std::make_pair(percent_decode(a), std::string{});
-        return std::make_pair(percent_decode(a.substr(0, pos)), percent_decode(a.substr(pos + 1)));
+    // first structural position >= from, or s.size()
+    constexpr size_t next(size_t from) {
+        if (std::is_constant_evaluated()) {
+            for (; from < s_.size(); ++from)
+                for (char c : kStructural)
+                    if (s_[from] == c) return from;
+            return s_.size();
+        }
+        while (from < s_.size()) {
+            if (from < base_ || from - base_ >= 64) load(from);
+            uint64_t m = mask_ & (~0ULL << (from - base_));
+            if (m) return base_ + __builtin_ctzll(m);
+            from = base_ + 64;
+        }
+        return s_.size();
     }
-    const std::vector<HostPort>& hosts() const { return hosts_; }
-    std::string                  path() const { return percent_decode(path_); }
-    const std::string&           raw_path() const { return path_; }
-    std::optional<std::string> query() const { return query_ ? std::optional(percent_decode(*query_)) : std::nullopt; }
-    const std::optional<std::string>& raw_query() const { return query_; }
-    const std::optional<std::string>& fragment() const { return fragment_; }
 
-    // Parse and return a URI object. Throws parse_error on invalid input
-    URI(std::string input) : uri_(std::move(input)) {
-        const char* s   = uri_.c_str();
-        size_t      len = uri_.size();
-        size_t      i   = 0;
-
-        if (len == 0) throw parse_error("empty input");
-
-        auto is_scheme_char = [](char c, size_t pos) -> bool {
-            if (pos == 0) return std::isalpha((unsigned char)c);
-            return std::isalnum((unsigned char)c) || c == '+' || c == '-' || c == '.';
-        };
-
-        // find ':' for scheme
-        size_t scheme_end = uri_.find(':');
-        if (scheme_end == std::string::npos) throw parse_error("missing scheme");
-        if (scheme_end == 0) throw parse_error("empty scheme");
-        for (size_t k = 0; k < scheme_end; ++k)
-            if (!is_scheme_char(uri_[k], k)) throw parse_error("invalid scheme char");
-        this->scheme_ = uri_.substr(0, scheme_end);
-
-        i = scheme_end + 1;
-
-        // authority
-        if (i + 1 < len && s[i] == '/' && s[i + 1] == '/') {
-            i += 2;
-            has_authority_    = true;
-            size_t auth_start = i;
-            size_t auth_end   = i;
-            while (auth_end < len && s[auth_end] != '/' && s[auth_end] != '?' && s[auth_end] != '#') ++auth_end;
-            // parse authority between auth_start and auth_end
-            if (auth_end > auth_start) {
-                std::string auth = uri_.substr(auth_start, auth_end - auth_start);
-                // find last '@' not inside brackets
-                int    bracket = 0;
-                size_t at_pos  = std::string::npos;
-                for (size_t k = 0; k < auth.size(); ++k) {
-                    char c = auth[k];
-                    if (c == '[')
-                        ++bracket;
-                    else if (c == ']')
-                        --bracket;
-                    else if (c == '@' && bracket == 0)
-                        at_pos = k;
-                }
-                std::string hostportlist;
-                if (at_pos != std::string::npos) {
-                    this->authority_ = auth.substr(0, at_pos);
-                    hostportlist     = auth.substr(at_pos + 1);
-                } else
-                    hostportlist = auth;
-
-                // split by comma only
-                size_t start = 0;
-                for (size_t k = 0; k <= hostportlist.size(); ++k) {
-                    if (k == hostportlist.size() || hostportlist[k] == ',') {
-                        if (k > start) {
-                            std::string item = hostportlist.substr(start, k - start);
-                            trim_space(item);
-                            if (!item.empty()) this->hosts_.push_back(parse_hostport(item));
+    // first position in [from, end) holding one of `set` (all structural), or end
+    template <size_t N>
+    constexpr size_t find(size_t from, const char (&set)[N], size_t end = SIZE_MAX) {
+        end = std::min(end, s_.size());
+        for (size_t k = next(from); k < end; k = next(k + 1))
+            for (size_t j = 0; j + 1 < N; ++j)
+                if (s_[k] == set[j]) return k;
+        return end;
+    }
+
+   private:
+    void load(size_t from) {
+        base_ = from;
+        if (s_.size() - from >= 64) {
+            mask_ = scan_(s_.data() + from);
+        } else {
+            // tail: pad with a non-structural byte
+            char buf[64] = {};
+            std::memcpy(buf, s_.data() + from, s_.size() - from);
+            mask_ = scan_(buf);
+        }
+    }
+
+    std::string_view s_;
+    block_scanner    scan_ = nullptr;
+    size_t           base_ = SIZE_MAX;
+    uint64_t         mask_ = 0;
+};
+
+// Percent-coding kernels. Membership sets are 256-bit bitmaps; the vector kernel looks
+// bytes up through two 16-entry nibble tables (pshufb), so any set costs the same.
+struct byte_set {
+    uint64_t bits[4]    = {};
+    uint8_t  lo_tab[16] = {};  // bit h set: (h << 4 | low nibble) is a member, h < 8
+    uint8_t  hi_tab[16] = {};  // same for h + 8
+
+    constexpr bool has(unsigned char c) const { return bits[c >> 6] >> (c & 63) & 1; }
+    constexpr void add(unsigned char c) {
+        bits[c >> 6] |= 1ULL << (c & 63);
+        if (c < 0x80)
+            lo_tab[c & 15] |= uint8_t(1 << (c >> 4));
+        else
+            hi_tab[c & 15] |= uint8_t(1 << ((c >> 4) - 8));
+    }
+    constexpr void add(std::string_view chars) {
+        for (char c : chars) add((unsigned char)c);
+    }
+    constexpr byte_set operator~() const {
+        byte_set r;
+        for (int k = 0; k < 4; ++k) r.bits[k] = ~bits[k];
+        for (int k = 0; k < 16; ++k) {
+            r.lo_tab[k] = uint8_t(~lo_tab[k]);
+            r.hi_tab[k] = uint8_t(~hi_tab[k]);
+        }
+        return r;
+    }
+};
+
+inline constexpr byte_set kUnreserved = [] {
+    byte_set s;
+    s.add("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-._~");
+    return s;
+}();
+
+// hex digit value, -1 for non-hex bytes
+inline constexpr std::array<int8_t, 256> kHexVal = [] {
+    std::array<int8_t, 256> t{};
+    for (auto& v : t) v = -1;
+    for (int c = '0'; c <= '9'; ++c) t[c] = int8_t(c - '0');
+    for (int c = 'a'; c <= 'f'; ++c) t[c] = int8_t(c - 'a' + 10);
+    for (int c = 'A'; c <= 'F'; ++c) t[c] = int8_t(c - 'A' + 10);
+    return t;
+}();
+
+inline constexpr char kHexDigits[] = "0123456789ABCDEF";
+
+// first index in [0, n) whose byte is in `set`, or n
+typedef size_t (*set_finder)(const char* p, size_t n, const byte_set& set);
+
+inline size_t find_in_set_scalar(const char* p, size_t n, const byte_set& set) {
+    for (size_t i = 0; i < n; ++i)
+        if (set.has((unsigned char)p[i])) return i;
+    return n;
+}
+
+#ifdef CPPTOOLS_URI_X86
+__attribute__((target("avx2"))) inline size_t find_in_set_avx2(const char* p, size_t n, const byte_set& set) {
+    const __m256i tlo = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(set.lo_tab)));
+    const __m256i thi = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(set.hi_tab)));
+    const __m256i bitsel =
+        _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1,
+                         2, 4, 8, 16, 32, 64, -128);
+    const __m256i nib  = _mm256_set1_epi8(0x0F);
+    const __m256i zero = _mm256_setzero_si256();
+    size_t        i    = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        __m256i lo = _mm256_and_si256(v, nib);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nib);
+        // the top bit of v selects the table for high nibbles 8..15
+        __m256i row  = _mm256_blendv_epi8(_mm256_shuffle_epi8(tlo, lo), _mm256_shuffle_epi8(thi, lo), v);
+        __m256i bit  = _mm256_shuffle_epi8(bitsel, hi);
+        uint32_t out = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(row, bit), zero)));
+        if (out != UINT32_MAX) return i + __builtin_ctz(~out);
+    }
+    return i + find_in_set_scalar(p + i, n - i, set);
+}
+#endif
+
+inline set_finder active_set_finder() {
+    static const set_finder fn = [] {
+#ifdef CPPTOOLS_URI_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return &find_in_set_avx2;
+#endif
+        return &find_in_set_scalar;
+    }();
+    return fn;
+}
+
+inline size_t find_in_set(const char* p, size_t n, const byte_set& set) {
+    return n < 32 ? find_in_set_scalar(p, n, set) : active_set_finder()(p, n, set);
+}
+
+// Decode `in` into `out`, which must hold in.size() bytes and may alias in.data().
+// Runs without '%' are located with memchr and moved in one block. Returns bytes written.
+inline size_t percent_decode_to(std::string_view in, char* out) {
+    const char* p = in.data();
+    size_t      n = in.size(), i = 0, o = 0;
+    while (i < n) {
+        const void* hit = std::memchr(p + i, '%', n - i);
+        size_t      run = (hit ? static_cast<const char*>(hit) - p : n) - i;
+        if (out + o != p + i) std::memmove(out + o, p + i, run);
+        i += run;
+        o += run;
+        if (i == n) break;
+        int h1 = i + 2 < n ? kHexVal[(unsigned char)p[i + 1]] : -1;
+        int h2 = i + 2 < n ? kHexVal[(unsigned char)p[i + 2]] : -1;
+        if (h1 >= 0 && h2 >= 0) {
+            out[o++] = static_cast<char>(h1 << 4 | h2);
+            i += 3;
+        } else {
+            out[o++] = '%';
+            ++i;
+        }
+    }
+    return o;
+}
+
+// Append `in` to `out`, escaping every byte outside `keep`.
+inline void percent_encode_to(std::string_view in, const byte_set& keep, std::string& out) {
+    const byte_set escape = ~keep;
+    const char*    p      = in.data();
+    size_t         n = in.size(), i = 0;
+    while (i < n) {
+        size_t run = find_in_set(p + i, n - i, escape);
+        out.append(p + i, run);
+        i += run;
+        if (i == n) break;
+        unsigned char c = p[i++];
+        char          esc[3] = {'%', kHexDigits[c >> 4], kHexDigits[c & 0xF]};
+        out.append(esc, 3);
+    }
+}
+
+constexpr uri_error fail(uri_errc code, size_t offset) { return uri_error{code, uint32_t(offset)}; }
+
+// Every helper below reports failure through a uri_error whose offset is relative to
+// its own argument, so the view parser never throws or allocates.
+constexpr uri_error parse_port(std::string_view s, uint16_t& port) {
+    if (s.empty()) return fail(uri_errc::empty_port, 0);
+    if (s.size() > 1 && s[0] == '0') return fail(uri_errc::port_leading_zero, 0);
+    int val = 0;
+    for (size_t k = 0; k < s.size(); ++k) {
+        char c = s[k];
+        if (!is_digit(c)) return fail(uri_errc::port_not_digit, k);
+        val = val * 10 + (c - '0');
+        if (val > 65535) return fail(uri_errc::port_out_of_range, k);
+    }
+    port = static_cast<uint16_t>(val);
+    return {};
+}
+
+// Hand-written IP literal parsers: validate while converting and report false for
+// anything else, so the caller can keep the host as a reg-name.
+
+// dotted quad, no leading zeros (which inet_aton would read as octal)
+constexpr bool parse_ipv4(std::string_view s, uint8_t* out) {
+    size_t i = 0;
+    for (int part = 0; part < 4; ++part) {
+        if (part) {
+            if (i >= s.size() || s[i] != '.') return false;
+            ++i;
+        }
+        size_t start = i;
+        unsigned val = 0;
+        while (i < s.size() && is_digit(s[i]) && i - start < 3) val = val * 10 + unsigned(s[i++] - '0');
+        if (i == start || val > 255 || (s[start] == '0' && i - start > 1)) return false;
+        out[part] = uint8_t(val);
+    }
+    return i == s.size();
+}
+
+// RFC 4291 text form with optional "::", embedded IPv4 tail and zone id
+constexpr bool parse_ipv6(std::string_view s, bool raw, IPAddr& ip) {
+    if (size_t pct = s.find('%'); pct != std::string_view::npos) {
+        auto zone = zone_of(s, raw);
+        if (zone.empty()) return false;
+        ip.has_zone = true;
+        ip.scope_id = 0;
+        uint64_t id = 0;
+        bool     numeric = true;
+        for (char c : zone) {
+            numeric = numeric && is_digit(c);
+            id      = id * 10 + uint64_t(c - '0');
+            if (numeric && id > UINT32_MAX) return false;
+        }
+        if (numeric) ip.scope_id = uint32_t(id);
+        s = s.substr(0, pct);
+    }
+
+    uint16_t words[8] = {};
+    int      n = 0, gap = -1;
+    size_t   i = 0;
+    if (s.starts_with("::")) {
+        gap = 0;
+        i   = 2;
+    } else if (s.empty() || s[0] == ':') {
+        return false;
+    }
+    while (i < s.size()) {
+        size_t   start = i;
+        unsigned val   = 0;
+        while (i < s.size() && i - start < 4 && kHexVal[(unsigned char)s[i]] >= 0)
+            val = val << 4 | unsigned(kHexVal[(unsigned char)s[i++]]);
+        if (i < s.size() && s[i] == '.') {
+            // embedded IPv4 in the last 32 bits
+            uint8_t v4[4] = {};
+            if (n > 6 || !parse_ipv4(s.substr(start), v4)) return false;
+            words[n++] = uint16_t(v4[0] << 8 | v4[1]);
+            words[n++] = uint16_t(v4[2] << 8 | v4[3]);
+            i          = s.size();
+            break;
+        }
+        if (i == start || n == 8) return false;
+        words[n++] = uint16_t(val);
+        if (i == s.size()) break;
+        if (s[i++] != ':') return false;
+        if (i < s.size() && s[i] == ':') {
+            if (gap >= 0) return false;
+            gap = n;
+            ++i;
+        } else if (i == s.size()) {
+            return false;  // trailing single ':'
+        }
+    }
+    if (gap < 0 ? n != 8 : n > 7) return false;
+
+    int out = 0;
+    for (int k = 0; k < (gap < 0 ? n : gap); ++k, ++out) {
+        ip.bytes[2 * out]     = uint8_t(words[k] >> 8);
+        ip.bytes[2 * out + 1] = uint8_t(words[k]);
+    }
+    if (gap >= 0) {
+        out = 8 - (n - gap);
+        for (int k = gap; k < n; ++k, ++out) {
+            ip.bytes[2 * out]     = uint8_t(words[k] >> 8);
+            ip.bytes[2 * out + 1] = uint8_t(words[k]);
+        }
+    }
+    ip.family = IPAddr::v6;
+    return true;
+}
+
+// IP literal or reg-name? Raw hosts carry "%25" zone delimiters, decoded ones '%'.
+constexpr IPAddr parse_ip(std::string_view host, bool raw) {
+    IPAddr ip;
+    if (!host.empty() && is_digit(host[0]) && host.find(':') == std::string_view::npos) {
+        if (parse_ipv4(host, ip.bytes.data())) ip.family = IPAddr::v4;
+    } else if (host.find(':') != std::string_view::npos && !parse_ipv6(host, raw, ip)) {
+        ip = IPAddr{};
+    }
+    return ip;
+}
+
+// split one trimmed, non-empty host list item into host and optional port
+constexpr uri_error split_hostport(std::string_view item, HostPortView& hp) {
+    hp = HostPortView{};
+    if (item[0] == '[') {
+        // IPv6 literal
+        size_t rb = item.find(']');
+        if (rb == std::string_view::npos) return fail(uri_errc::unclosed_ipv6_bracket, 0);
+        hp.host = item.substr(1, rb - 1);
+        if (!parse_ipv6(hp.host, true, hp.ip)) hp.ip = IPAddr{};
+        if (rb + 1 == item.size()) return {};
+        if (item[rb + 1] != ':') return fail(uri_errc::bad_ipv6_suffix, rb + 1);
+        uint16_t port = 0;
+        if (auto err = parse_port(item.substr(rb + 2), port)) return fail(err.code, err.offset + rb + 2);
+        hp.port = port;
+        return {};
+    }
+    size_t colon = item.rfind(':');
+    // if multiple ':' present and not bracketed, treat as host
+    // (non-bracketed IPv6) to avoid misparse
+    if (colon == std::string_view::npos || item.find(':') != colon) {
+        hp.host = item;
+        hp.ip   = parse_ip(item, true);
+        return {};
+    }
+    hp.host       = item.substr(0, colon);
+    hp.ip         = parse_ip(hp.host, true);
+    uint16_t port = 0;
+    if (auto err = parse_port(item.substr(colon + 1), port)) return fail(err.code, err.offset + colon + 1);
+    hp.port = port;
+    return {};
+}
+
+// Split [begin, end) of `s` on ',' and validate every item now, so iterating hosts later
+// cannot fail. Strict mode also rejects empty items, empty reg-names and unbracketed ':'.
+constexpr uri_error split_hostlist(std::string_view s, size_t begin, size_t end, uri_layout& l, parse_mode mode) {
+    l.hostlist = span::of(begin, end);
+    if (begin == end) return {};
+    for (size_t start = begin; start <= end;) {
+        size_t k    = std::min(s.find(',', start), end);
+        auto   item = trim_space(s.substr(start, k - start));
+        size_t at   = item.empty() ? start : item.data() - s.data();
+        if (!item.empty()) {
+            HostPortView hp;
+            if (auto err = split_hostport(item, hp)) return fail(err.code, err.offset + at);
+            if (mode == parse_mode::strict && item[0] != '[' &&
+                (hp.host.empty() || hp.host.find(':') != std::string_view::npos))
+                return fail(uri_errc::bad_host, at);
+            // brackets hold an IPv6 address or an IPvFuture ("v1.xyz"), nothing else
+            if (mode == parse_mode::strict && item[0] == '[' && !hp.ip &&
+                !(hp.host.size() > 1 && (hp.host[0] == 'v' || hp.host[0] == 'V')))
+                return fail(uri_errc::bad_host, at + 1);
+            if (l.host_count == UINT16_MAX) return fail(uri_errc::too_many_hosts, at);
+            ++l.host_count;
+        } else if (mode == parse_mode::strict) {
+            return fail(uri_errc::bad_host, at);
+        }
+        start = k + 1;
+    }
+    return {};
+}
+
+// Locate every component of `s` without copying anything.
+constexpr uri_error parse_layout_lenient(std::string_view s, uri_layout& l) {
+    const size_t len = s.size();
+    size_t       i   = 0;
+
+    structural_cursor cur(s);
+
+    // find ':' for scheme
+    size_t scheme_end = cur.find(0, ":");
+    if (scheme_end == len) return fail(uri_errc::missing_scheme, len);
+    if (scheme_end == 0) return fail(uri_errc::empty_scheme, 0);
+    for (size_t k = 0; k < scheme_end; ++k)
+        if (!is_scheme_char(s[k], k)) return fail(uri_errc::invalid_scheme_char, k);
+    l.scheme = span::of(0, scheme_end);
+
+    i = scheme_end + 1;
+
+    // authority
+    if (i + 1 < len && s[i] == '/' && s[i + 1] == '/') {
+        i += 2;
+        l.has_authority   = true;
+        size_t auth_start = i;
+        size_t auth_end   = len;
+
+        // find the end of the authority and the last '@' not inside brackets in one walk
+        int    bracket = 0;
+        size_t at_pos  = std::string_view::npos;
+        for (size_t k = cur.next(auth_start); k < len; k = cur.next(k + 1)) {
+            char c = s[k];
+            if (c == '/' || c == '?' || c == '#') {
+                auth_end = k;
+                break;
+            }
+            if (c == '[')
+                ++bracket;
+            else if (c == ']')
+                --bracket;
+            else if (c == '@' && bracket == 0)
+                at_pos = k;
+        }
+        size_t hosts_start = auth_start;
+        if (at_pos != std::string_view::npos) {
+            l.has_userinfo = true;
+            l.userinfo     = span::of(auth_start, at_pos);
+            hosts_start    = at_pos + 1;
+        }
+        if (auto err = split_hostlist(s, hosts_start, auth_end, l, parse_mode::lenient)) return err;
+        i = auth_end;
+    }
+
+    // path
+    size_t path_start = i;
+    i                 = cur.find(i, "?#");
+    l.path            = span::of(path_start, i);
+
+    if (i < len && s[i] == '?') {
+        size_t qstart = ++i;
+        i             = cur.find(i, "#");
+        l.has_query   = true;
+        l.query       = span::of(qstart, i);
+    }
+    if (i < len && s[i] == '#') {
+        ++i;
+        l.has_fragment = true;
+        l.fragment     = span::of(i, len);
+    }
+    return {};
+}
+
+// Strict mode: a table-driven DFA validates every byte against the character set of the
+// component it belongs to while recording component boundaries, so validation costs no
+// extra pass. Each percent-capable component has two states for the hex digits.
+enum dstate : uint8_t {
+    S_SCHEME0,
+    S_SCHEME,
+    S_AFTER_SCHEME,  // just after "scheme:"
+    S_SLASH1,        // "scheme:/"
+    S_AUTH,
+    S_AUTH_P1,
+    S_AUTH_P2,
+    S_V6,  // inside '[' ... ']'
+    S_V6_P1,
+    S_V6_P2,
+    S_V6_END,  // just after ']'
+    S_PATH,
+    S_PATH_P1,
+    S_PATH_P2,
+    S_QUERY,
+    S_QUERY_P1,
+    S_QUERY_P2,
+    S_FRAG,
+    S_FRAG_P1,
+    S_FRAG_P2,
+    S_ERROR,
+    S_COUNT
+};
+
+inline constexpr auto kTransition = [] {
+    std::array<std::array<uint8_t, C_COUNT>, S_COUNT> t{};
+    for (auto& row : t) row.fill(S_ERROR);
+    auto on = [&t](dstate from, std::initializer_list<cclass> cs, dstate to) {
+        for (auto c : cs) t[from][c] = to;
+    };
+    auto pct = [&](dstate base, dstate p1, dstate p2) {
+        on(base, {C_PERCENT}, p1);
+        on(p1, {C_HEXALPHA, C_DIGIT}, p2);
+        on(p2, {C_HEXALPHA, C_DIGIT}, base);
+    };
+    const auto unreserved = {C_HEXALPHA, C_ALPHA, C_DIGIT, C_DASHDOT, C_UNDERTILDE};
+    const auto sub_delims = {C_PLUS, C_SUBDELIM, C_COMMA};
+    // after the authority (or scheme) every component may start
+    auto enter_path = [&](dstate from) {
+        on(from, unreserved, S_PATH);
+        on(from, sub_delims, S_PATH);
+        on(from, {C_COLON, C_AT, C_SLASH}, S_PATH);
+        on(from, {C_PERCENT}, S_PATH_P1);
+        on(from, {C_QUESTION}, S_QUERY);
+        on(from, {C_HASH}, S_FRAG);
+    };
+
+    on(S_SCHEME0, {C_HEXALPHA, C_ALPHA}, S_SCHEME);
+    on(S_SCHEME, {C_HEXALPHA, C_ALPHA, C_DIGIT, C_PLUS, C_DASHDOT}, S_SCHEME);
+    on(S_SCHEME, {C_COLON}, S_AFTER_SCHEME);
+
+    enter_path(S_AFTER_SCHEME);
+    on(S_AFTER_SCHEME, {C_SLASH}, S_SLASH1);
+    enter_path(S_SLASH1);
+    on(S_SLASH1, {C_SLASH}, S_AUTH);
+
+    // userinfo and host list are told apart by the last '@' once the authority ends
+    enter_path(S_AUTH);
+    on(S_AUTH, unreserved, S_AUTH);
+    on(S_AUTH, sub_delims, S_AUTH);
+    on(S_AUTH, {C_COLON, C_AT}, S_AUTH);
+    on(S_AUTH, {C_SLASH}, S_PATH);
+    on(S_AUTH, {C_LBRACKET}, S_V6);
+    pct(S_AUTH, S_AUTH_P1, S_AUTH_P2);
+
+    on(S_V6, unreserved, S_V6);
+    on(S_V6, {C_COLON}, S_V6);
+    on(S_V6, {C_RBRACKET}, S_V6_END);
+    pct(S_V6, S_V6_P1, S_V6_P2);  // zone id
+    on(S_V6_END, {C_COLON, C_COMMA}, S_AUTH);
+    on(S_V6_END, {C_SLASH}, S_PATH);
+    on(S_V6_END, {C_QUESTION}, S_QUERY);
+    on(S_V6_END, {C_HASH}, S_FRAG);
+
+    enter_path(S_PATH);
+    pct(S_PATH, S_PATH_P1, S_PATH_P2);
+
+    for (auto [base, p1, p2] :
+         {std::array{S_QUERY, S_QUERY_P1, S_QUERY_P2}, std::array{S_FRAG, S_FRAG_P1, S_FRAG_P2}}) {
+        on(base, unreserved, base);
+        on(base, sub_delims, base);
+        on(base, {C_COLON, C_AT, C_SLASH, C_QUESTION}, base);
+        pct(base, p1, p2);
+    }
+    on(S_QUERY, {C_HASH}, S_FRAG);
+    return t;
+}();
+
+constexpr uri_errc dfa_error(dstate st, cclass c) {
+    switch (st) {
+        case S_SCHEME0: return c == C_COLON ? uri_errc::empty_scheme : uri_errc::invalid_scheme_char;
+        case S_SCHEME: return uri_errc::invalid_scheme_char;
+        case S_AUTH_P1:
+        case S_AUTH_P2:
+        case S_V6_P1:
+        case S_V6_P2:
+        case S_PATH_P1:
+        case S_PATH_P2:
+        case S_QUERY_P1:
+        case S_QUERY_P2:
+        case S_FRAG_P1:
+        case S_FRAG_P2: return uri_errc::bad_percent_encoding;
+        default: return uri_errc::invalid_char;
+    }
+}
+
+// The strict DFA with its boundary bookkeeping, resumable: feed() may be called on
+// successive prefixes of the same input, so streamed input is validated as it arrives.
+struct strict_scanner {
+    static constexpr size_t npos = std::string_view::npos;
+
+    size_t scheme_end = 0, auth_end = npos, at_pos = npos;
+    size_t query_at = npos, frag_at = npos;  // position of the '?' / '#' delimiter
+    bool   bracket_seen  = false;
+    bool   has_authority = false;
+    dstate st            = S_SCHEME0;
+
+    // scan s[from, s.size()); everything before `from` was fed earlier
+    constexpr uri_error feed(std::string_view s, size_t from) {
+        for (size_t i = from; i < s.size(); ++i) {
+            cclass c  = char_class(s[i]);
+            dstate nx = dstate(kTransition[st][c]);
+            if (nx == S_ERROR) return fail(dfa_error(st, c), i);
+            if (c >= C_COMMA && c <= C_RBRACKET) {
+                // component boundaries only ever happen on delimiters
+                switch (st) {
+                    case S_SCHEME: scheme_end = i; break;
+                    case S_SLASH1:
+                        if (nx == S_AUTH) has_authority = true;
+                        break;
+                    case S_AUTH:
+                    case S_V6_END:
+                        if (c == C_AT) {
+                            // one '@' at most, and no IP literal inside the userinfo
+                            if (at_pos != npos || bracket_seen) return fail(uri_errc::invalid_char, i);
+                            at_pos = i;
+                        } else if (c == C_LBRACKET) {
+                            // an IP literal is a whole host item, never part of a reg-name
+                            char prev = s[i - 1];
+                            if (prev != '/' && prev != '@' && prev != ',') return fail(uri_errc::invalid_char, i);
+                            bracket_seen = true;
+                        } else if (nx != S_AUTH && nx != S_V6) {
+                            auth_end = i;
                         }
-                        start = k + 1;
-                    }
+                        break;
+                    default: break;
                 }
+                if (c == C_QUESTION && nx == S_QUERY && st != S_QUERY)
+                    query_at = i;
+                else if (c == C_HASH && nx == S_FRAG)
+                    frag_at = i;
             }
-            i = auth_end;
+            st = nx;
         }
+        return {};
+    }
 
-        // path
-        size_t path_start = i;
-        while (i < len && s[i] != '?' && s[i] != '#') ++i;
-        this->path_ = uri_.substr(path_start, i - path_start);
-        // if (this->path_.empty() && !this->hosts_.empty()) this->path_ =
-        // std::string("/");
+    // end of input: check the final state and lay out the components of `s`
+    constexpr uri_error finish(std::string_view s, uri_layout& l) const {
+        const size_t len = s.size();
+        switch (st) {
+            case S_SCHEME0:
+            case S_SCHEME: return fail(uri_errc::missing_scheme, len);
+            case S_V6:
+            case S_V6_P1:
+            case S_V6_P2: return fail(uri_errc::unclosed_ipv6_bracket, len);
+            case S_AUTH_P1:
+            case S_AUTH_P2:
+            case S_PATH_P1:
+            case S_PATH_P2:
+            case S_QUERY_P1:
+            case S_QUERY_P2:
+            case S_FRAG_P1:
+            case S_FRAG_P2: return fail(uri_errc::bad_percent_encoding, len);
+            default: break;
+        }
 
-        if (i < len && s[i] == '?') {
-            ++i;
-            size_t qstart = i;
-            while (i < len && s[i] != '#') ++i;
-            this->query_ = uri_.substr(qstart, i - qstart);
+        const size_t q = std::min(query_at, len), f = std::min(frag_at, len);
+        l.scheme          = span::of(0, scheme_end);
+        l.has_authority   = has_authority;
+        size_t path_start = scheme_end + 1;
+        if (has_authority) {
+            size_t auth_start  = scheme_end + 3;
+            size_t hosts_start = auth_start;
+            size_t hosts_end   = std::min(auth_end, len);
+            if (at_pos != npos) {
+                l.has_userinfo = true;
+                l.userinfo     = span::of(auth_start, at_pos);
+                hosts_start    = at_pos + 1;
+            }
+            if (auto err = split_hostlist(s, hosts_start, hosts_end, l, parse_mode::strict)) return err;
+            path_start = hosts_end;
+        }
+        l.path = span::of(path_start, std::min(q, f));
+        if (q < f) {
+            l.has_query = true;
+            l.query     = span::of(q + 1, f);
         }
-        if (i < len && s[i] == '#') {
+        if (f < len) {
+            l.has_fragment = true;
+            l.fragment     = span::of(f + 1, len);
+        }
+        return {};
+    }
+};
+
+constexpr uri_error parse_layout_strict(std::string_view s, uri_layout& l) {
+    strict_scanner scan;
+    if (auto err = scan.feed(s, 0)) return err;
+    return scan.finish(s, l);
+}
+
+constexpr uri_error parse_layout(std::string_view s, uri_layout& l, parse_mode mode = parse_mode::lenient) {
+    l = uri_layout{};
+    if (s.empty()) return fail(uri_errc::empty_input, 0);
+    if (s.size() > UINT32_MAX) return fail(uri_errc::input_too_long, UINT32_MAX);
+    return mode == parse_mode::strict ? parse_layout_strict(s, l) : parse_layout_lenient(s, l);
+}
+
+// Deliberately not constexpr: reaching it during constant evaluation turns a malformed
+// URI constant into a compile error that names it.
+inline void invalid_uri_constant(uri_errc, uint32_t /* offset */) {}
+
+// Does the percent-encoded `raw` decode to exactly `plain`? Decodes on the fly, no buffer.
+constexpr bool decoded_equals(std::string_view raw, std::string_view plain) {
+    size_t i = 0, j = 0;
+    for (; i < raw.size(); ++j) {
+        if (j == plain.size()) return false;
+        char c = raw[i];
+        int  h1, h2;
+        if (c == '%' && i + 2 < raw.size() && (h1 = kHexVal[(unsigned char)raw[i + 1]]) >= 0 &&
+            (h2 = kHexVal[(unsigned char)raw[i + 2]]) >= 0) {
+            c = char(h1 << 4 | h2);
+            i += 3;
+        } else {
             ++i;
-            this->fragment_ = uri_.substr(i);
         }
+        if (c != plain[j]) return false;
+    }
+    return j == plain.size();
+}
+
+}  // namespace detail
+
+// One raw "key[=value]" pair of a query string; decoding happens only on request.
+struct QueryParam {
+    std::string_view key;        // raw, still percent-encoded
+    std::string_view value;      // raw, empty when there is no '='
+    bool             has_value = false;  // false for "flag" parameters without '='
+
+    constexpr bool key_is(std::string_view plain) const { return detail::decoded_equals(key, plain); }
+    std::string decoded_key() const { return decode(key); }
+    std::string decoded_value() const { return decode(value); }
+
+   private:
+    static std::string decode(std::string_view in) {
+        std::string str(in.size(), '\0');
+        str.resize(detail::percent_decode_to(in, str.data()));
+        return str;
+    }
+};
+
+// Lazily splits a raw query on '&' (empty segments are skipped); never allocates.
+class QueryRange {
+   public:
+    class iterator {
+       public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = QueryParam;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const QueryParam*;
+        using reference         = const QueryParam&;
+
+        constexpr iterator() = default;
+        constexpr reference operator*() const { return cur_; }
+        constexpr pointer   operator->() const { return &cur_; }
+        constexpr iterator& operator++() {
+            advance();
+            return *this;
+        }
+        constexpr iterator  operator++(int) {
+            auto t = *this;
+            advance();
+            return t;
+        }
+        constexpr bool      operator==(const iterator& o) const { return at_ == o.at_; }
+
+       private:
+        friend class QueryRange;
+        constexpr explicit iterator(std::string_view q) : q_(q) { advance(); }
+
+        constexpr void advance() {
+            while (next_ <= q_.size()) {
+                size_t k = std::min(q_.find('&', next_), q_.size());
+                auto   p = q_.substr(next_, k - next_);
+                at_      = next_;
+                next_    = k + 1;
+                if (p.empty()) continue;
+                size_t eq = p.find('=');
+                if (eq == std::string_view::npos)
+                    cur_ = QueryParam{p, {}, false};
+                else
+                    cur_ = QueryParam{p.substr(0, eq), p.substr(eq + 1), true};
+                return;
+            }
+            at_ = std::string_view::npos;
+        }
+
+        std::string_view q_;
+        size_t           next_ = 0;
+        size_t           at_   = std::string_view::npos;
+        QueryParam       cur_{};
+    };
+
+    constexpr QueryRange() = default;
+    constexpr explicit QueryRange(std::string_view raw_query) : q_(raw_query) {}
+
+    constexpr iterator begin() const { return q_.empty() ? iterator() : iterator(q_); }
+    constexpr iterator end() const { return iterator(); }
+    constexpr bool     empty() const { return begin() == end(); }
+
+    // raw value of the first parameter whose decoded key equals `key`
+    constexpr std::optional<std::string_view> get(std::string_view key) const {
+        for (const auto& p : *this)
+            if (p.key_is(key)) return p.value;
+        return std::nullopt;
+    }
+
+   private:
+    std::string_view q_;
+};
+
+// Flat lookup table over a query, built once for repeated get() calls. The first 8
+// decoded bytes of every key are packed into a uint64_t, so a lookup is a linear scan
+// over a small contiguous array the compiler can vectorize; only keys longer than 8
+// bytes need a full comparison. Up to kInline parameters are stored without allocating.
+class QueryIndex {
+   public:
+    static constexpr size_t kInline = 16;
+
+    QueryIndex() = default;
+    explicit QueryIndex(std::string_view raw_query) {
+        for (const auto& p : QueryRange(raw_query)) add(p);
+    }
+
+    size_t size() const { return size_; }
+
+    // raw value of the first parameter whose decoded key equals `key`
+    std::optional<std::string_view> get(std::string_view key) const {
+        const uint64_t pfx = pack(key);
+        const uint32_t len = uint32_t(key.size());
+        const size_t   n   = std::min(size_, kInline);
+        for (size_t k = 0; k < n; ++k)
+            if (prefix_[k] == pfx && key_len_[k] == len && (len <= 8 || params_[k].key_is(key)))
+                return params_[k].value;
+        for (size_t k = kInline; k < size_; ++k) {
+            const auto& e = overflow_[k - kInline];
+            if (e.prefix == pfx && e.key_len == len && (len <= 8 || e.param.key_is(key))) return e.param.value;
+        }
+        return std::nullopt;
+    }
+    bool contains(std::string_view key) const { return get(key).has_value(); }
 
-        // normalize host: percent-decode then lowercase
-        for (auto& hp : this->hosts_) {
-            hp.host = percent_decode(hp.host);
-            for (auto& c : hp.host) c = std::tolower((unsigned char)c);
+   private:
+    struct entry {
+        uint64_t   prefix;
+        uint32_t   key_len;
+        QueryParam param;
+    };
+
+    static uint64_t pack(std::string_view plain) {
+        uint64_t v = 0;
+        std::memcpy(&v, plain.data(), std::min<size_t>(plain.size(), 8));
+        return v;
+    }
+
+    void add(const QueryParam& p) {
+        // decoded length and first 8 decoded bytes, without a buffer
+        char     head[8] = {};
+        uint32_t len     = 0;
+        for (size_t i = 0; i < p.key.size(); ++len) {
+            char c = p.key[i];
+            int  h1, h2;
+            if (c == '%' && i + 2 < p.key.size() && (h1 = detail::kHexVal[(unsigned char)p.key[i + 1]]) >= 0 &&
+                (h2 = detail::kHexVal[(unsigned char)p.key[i + 2]]) >= 0) {
+                c = char(h1 << 4 | h2);
+                i += 3;
+            } else {
+                ++i;
+            }
+            if (len < 8) head[len] = c;
         }
+        uint64_t pfx = pack(std::string_view(head, std::min<uint32_t>(len, 8)));
+        if (size_ < kInline) {
+            prefix_[size_]  = pfx;
+            key_len_[size_] = len;
+            params_[size_]  = p;
+        } else {
+            overflow_.push_back(entry{pfx, len, p});
+        }
+        ++size_;
     }
 
-    // percent-decode a string -> std::string
-    static std::string percent_decode(std::string in) {
-        std::string str;
-        str.reserve(in.size());
-        for (size_t i = 0; i < in.size(); ++i) {
-            char c = in[i];
-            if (c == '%' && i + 2 < in.size()) {
-                char h1 = in[i + 1], h2 = in[i + 2];
-                if (is_hex(h1) && is_hex(h2)) {
-                    int val = hex_val(h1) * 16 + hex_val(h2);
-                    str.push_back(static_cast<char>(val));
-                    i += 2;
-                    continue;
+    size_t                          size_ = 0;
+    std::array<uint64_t, kInline>   prefix_{};
+    std::array<uint32_t, kInline>   key_len_{};
+    std::array<QueryParam, kInline> params_{};
+    std::vector<entry>              overflow_;
+};
+
+// Lazily splits the validated host list of a URIView; iteration never fails or allocates.
+class HostRange {
+   public:
+    class iterator {
+       public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = HostPortView;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const HostPortView*;
+        using reference         = const HostPortView&;
+
+        constexpr iterator() = default;
+        constexpr reference operator*() const { return cur_; }
+        constexpr pointer   operator->() const { return &cur_; }
+        constexpr iterator& operator++() {
+            advance();
+            return *this;
+        }
+        constexpr iterator  operator++(int) {
+            auto t = *this;
+            advance();
+            return t;
+        }
+        constexpr bool      operator==(const iterator& o) const { return at_ == o.at_; }
+
+       private:
+        friend class HostRange;
+        constexpr explicit iterator(std::string_view list) : list_(list) { advance(); }
+
+        constexpr void advance() {
+            while (next_ <= list_.size()) {
+                size_t k = list_.find(',', next_);
+                if (k == std::string_view::npos) k = list_.size();
+                auto item = detail::trim_space(list_.substr(next_, k - next_));
+                at_       = next_;
+                next_     = k + 1;
+                if (!item.empty()) {
+                    detail::split_hostport(item, cur_);
+                    return;
                 }
             }
-            str.push_back(c);
+            at_ = std::string_view::npos;
+        }
+
+        std::string_view list_;
+        size_t           next_ = 0;
+        size_t           at_   = std::string_view::npos;
+        HostPortView     cur_{};
+    };
+
+    constexpr HostRange() = default;
+    constexpr HostRange(std::string_view list, size_t count) : list_(list), count_(count) {}
+
+    constexpr iterator begin() const { return count_ ? iterator(list_) : iterator(); }
+    constexpr iterator end() const { return iterator(); }
+    constexpr size_t   size() const { return count_; }
+    constexpr bool     empty() const { return count_ == 0; }
+
+   private:
+    std::string_view list_;
+    size_t           count_ = 0;
+};
+
+// Non-owning parsed URI: every accessor returns a view into the caller's buffer,
+// which must outlive the URIView. Parsing performs no heap allocation.
+class URIView final {
+   public:
+    constexpr URIView() = default;
+
+    // Throws parse_error on invalid input; fails to compile when constant-evaluated
+    constexpr explicit URIView(std::string_view input, parse_mode mode = parse_mode::lenient) : uri_(input) {
+        if (auto err = detail::parse_layout(uri_, layout_, mode)) {
+            if (std::is_constant_evaluated()) detail::invalid_uri_constant(err.code, err.offset);
+            throw parse_error(err);
         }
+    }
+
+    // Non-throwing, non-allocating parse
+    static constexpr parse_result<URIView> try_parse(std::string_view input,
+                                                     parse_mode       mode = parse_mode::lenient) noexcept {
+        detail::uri_layout layout;
+        if (auto err = detail::parse_layout(input, layout, mode)) return err;
+        return URIView(input, layout);
+    }
+
+    constexpr std::string_view uri() const { return uri_; }
+    constexpr std::string_view scheme() const { return layout_.scheme.in(uri_); }
+    constexpr bool             has_authority() const { return layout_.has_authority; }
+    // raw (still percent-encoded) "user[:pass]" part of the authority
+    constexpr std::optional<std::string_view> userinfo() const {
+        return layout_.has_userinfo ? std::optional(layout_.userinfo.in(uri_)) : std::nullopt;
+    }
+    constexpr HostRange hosts() const { return HostRange(layout_.hostlist.in(uri_), layout_.host_count); }
+    constexpr std::string_view                raw_path() const { return layout_.path.in(uri_); }
+    constexpr std::optional<std::string_view> raw_query() const {
+        return layout_.has_query ? std::optional(layout_.query.in(uri_)) : std::nullopt;
+    }
+    constexpr std::optional<std::string_view> fragment() const {
+        return layout_.has_fragment ? std::optional(layout_.fragment.in(uri_)) : std::nullopt;
+    }
+    // raw key/value pairs of the query, split before any decoding
+    constexpr QueryRange query_params() const { return QueryRange(layout_.query.in(uri_)); }
+
+   private:
+    friend class URI;
+    friend class URIBatch;
+    friend class URIStreamParser;
+    constexpr URIView(std::string_view input, const detail::uri_layout& layout) : uri_(input), layout_(layout) {}
+
+    std::string_view   uri_;
+    detail::uri_layout layout_;
+};
+
+// Parse a constant URI at compile time; a malformed constant is a compile error
+// naming detail::invalid_uri_constant. Strict mode by default, since constants can
+// always be written in canonical form.
+consteval URIView parse_constant(std::string_view input, parse_mode mode = parse_mode::strict) {
+    return URIView(input, mode);
+}
+
+namespace literals {
+// constexpr auto u = "mongodb://a,b,c/db"_uri;
+consteval URIView operator""_uri(const char* s, size_t n) { return parse_constant(std::string_view(s, n)); }
+}  // namespace literals
+
+namespace detail {
+
+// RFC 3986 §6.2.3 scheme-based normalization: port implied by a well-known scheme
+constexpr bool iequals(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t k = 0; k < a.size(); ++k)
+        if (to_lower(a[k]) != to_lower(b[k])) return false;
+    return true;
+}
+
+constexpr std::optional<uint16_t> default_port(std::string_view scheme) {
+    constexpr std::pair<std::string_view, uint16_t> kPorts[] = {
+        {"http", 80}, {"https", 443}, {"ws", 80}, {"wss", 443}, {"ftp", 21},
+    };
+    for (const auto& [name, port] : kPorts)
+        if (iequals(scheme, name)) return port;
+    return std::nullopt;
+}
+
+// Stable 64-bit hash fed byte-wise but mixed in 8-byte little-endian words, so the
+// value neither depends on how the input is chunked nor on the platform.
+class uri_hasher {
+   public:
+    void push_back(char c) {
+        word_ |= uint64_t((unsigned char)c) << (8 * fill_);
+        if (++fill_ == 8) mix();
+    }
+    void append(std::string_view s) {
+        size_t i = 0;
+        for (; i < s.size() && fill_; ++i) push_back(s[i]);
+        for (; i + 8 <= s.size(); i += 8) {
+            std::memcpy(&word_, s.data() + i, 8);
+            if constexpr (std::endian::native == std::endian::big) word_ = __builtin_bswap64(word_);
+            mix();
+        }
+        for (; i < s.size(); ++i) push_back(s[i]);
+    }
+    uint64_t finish() const {
+        uint64_t h = (h_ ^ word_ ^ (len_ + fill_)) * 0x9E3779B97F4A7C15ULL;
+        // murmur3 fmix64
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+   private:
+    void mix() {
+        h_ = (h_ ^ word_) * 0x9E3779B97F4A7C15ULL;
+        h_ ^= h_ >> 29;
+        len_ += 8;
+        word_ = 0;
+        fill_ = 0;
+    }
+
+    uint64_t h_    = 0xCBF29CE484222325ULL;
+    uint64_t word_ = 0;
+    uint64_t len_  = 0;
+    unsigned fill_ = 0;
+};
+
+// Decoded byte at raw[i] (a valid triplet counts as one byte); advances i
+constexpr char next_decoded(std::string_view raw, size_t& i, bool& was_encoded) {
+    int h1, h2;
+    if (raw[i] == '%' && i + 2 < raw.size() && (h1 = kHexVal[(unsigned char)raw[i + 1]]) >= 0 &&
+        (h2 = kHexVal[(unsigned char)raw[i + 2]]) >= 0) {
+        i += 3;
+        was_encoded = true;
+        return char(h1 << 4 | h2);
+    }
+    was_encoded = false;
+    return raw[i++];
+}
+
+// §6.2.2.2: decode triplets of unreserved bytes, uppercase the hex of all others.
+// Bytes that were not encoded are copied untouched, so the output never grows.
+template <typename Sink>
+void canonical_percent(std::string_view raw, Sink& out) {
+    for (size_t i = 0; i < raw.size();) {
+        bool enc = false;
+        char c   = next_decoded(raw, i, enc);
+        if (!enc || kUnreserved.has((unsigned char)c)) {
+            out.push_back(c);
+        } else {
+            char esc[3] = {'%', kHexDigits[(unsigned char)c >> 4], kHexDigits[c & 0xF]};
+            out.append(std::string_view(esc, 3));
+        }
+    }
+}
+
+// host bytes allowed unescaped in a normalized reg-name (',' separates hosts here)
+inline constexpr byte_set kHostSafe = [] {
+    byte_set s = kUnreserved;
+    s.add("!$&'()*+;=");
+    return s;
+}();
+
+// Decode, lowercase and re-escape a host; IPv6 literals keep their colons and brackets
+template <typename Sink>
+void canonical_host(std::string_view raw, Sink& out) {
+    const bool ipv6 = raw.find(':') != std::string_view::npos;
+    if (ipv6) out.push_back('[');
+    for (size_t i = 0; i < raw.size();) {
+        bool enc = false;
+        char c   = to_lower(next_decoded(raw, i, enc));
+        if (kHostSafe.has((unsigned char)c) || (ipv6 && c == ':')) {
+            out.push_back(c);
+        } else {
+            char esc[3] = {'%', kHexDigits[(unsigned char)c >> 4], kHexDigits[c & 0xF]};
+            out.append(std::string_view(esc, 3));
+        }
+    }
+    if (ipv6) out.push_back(']');
+}
+
+// RFC 3986 §5.2.4 on an already percent-canonical path, in place: the output never
+// outruns the input it came from. Returns the new length.
+inline size_t remove_dot_segments(char* buf, size_t n) {
+    std::string_view in(buf, n);
+    size_t           o = 0;
+    auto pop_segment = [&] {
+        size_t slash = std::string_view(buf, o).rfind('/');
+        o            = slash == std::string_view::npos ? 0 : slash;
+    };
+    while (!in.empty()) {
+        if (in.starts_with("../")) {
+            in.remove_prefix(3);
+        } else if (in.starts_with("./") || in.starts_with("/./")) {
+            in.remove_prefix(2);
+        } else if (in == "/.") {
+            in = "/";
+        } else if (in.starts_with("/../")) {
+            in.remove_prefix(3);
+            pop_segment();
+        } else if (in == "/..") {
+            in = "/";
+            pop_segment();
+        } else if (in == "." || in == "..") {
+            in = {};
+        } else {
+            size_t end = in.find('/', 1);
+            if (end == std::string_view::npos) end = in.size();
+            std::memmove(buf + o, in.data(), end);
+            o += end;
+            in.remove_prefix(end);
+        }
+    }
+    return o;
+}
+
+// Sink that keeps the first N bytes on the stack and only then moves to the heap
+template <size_t N>
+class stack_sink {
+   public:
+    void push_back(char c) { append(std::string_view(&c, 1)); }
+    void append(std::string_view s) {
+        if (heap_.empty() && len_ + s.size() <= N) {
+            std::memcpy(buf_ + len_, s.data(), s.size());
+        } else {
+            if (heap_.empty()) heap_.assign(buf_, len_);
+            heap_.append(s);
+        }
+        len_ += s.size();
+    }
+    char*            data() { return heap_.empty() ? buf_ : heap_.data(); }
+    size_t           size() const { return len_; }
+    std::string_view view() const { return {heap_.empty() ? buf_ : heap_.data(), len_}; }
+
+   private:
+    char        buf_[N];
+    size_t      len_ = 0;
+    std::string heap_;
+};
+
+// Sink that checks the streamed bytes against `expected` instead of storing them
+class compare_sink {
+   public:
+    explicit compare_sink(std::string_view expected) : expected_(expected) {}
+    void push_back(char c) { append(std::string_view(&c, 1)); }
+    void append(std::string_view s) {
+        same_ = same_ && expected_.substr(pos_, s.size()) == s;
+        pos_ += s.size();
+    }
+    bool matches() const { return same_ && pos_ == expected_.size(); }
+
+   private:
+    std::string_view expected_;
+    size_t           pos_  = 0;
+    bool             same_ = true;
+};
+
+constexpr bool has_dot_segment(std::string_view path) {
+    for (size_t b = 0; b <= path.size();) {
+        size_t e   = std::min(path.find('/', b), path.size());
+        auto   seg = path.substr(b, e - b);
+        if (decoded_equals(seg, ".") || decoded_equals(seg, "..")) return true;
+        b = e + 1;
+    }
+    return false;
+}
+
+// Stream the RFC 3986 §6 normal form of `u` into `out`: lowercase scheme and hosts,
+// canonical percent-encoding, default ports dropped, dot-segments removed and an empty
+// path written as "/" for schemes with a default port.
+template <typename Sink>
+void normalize(const URIView& u, Sink& out) {
+    for (char c : u.scheme()) out.push_back(to_lower(c));
+    out.push_back(':');
+    const auto implied = default_port(u.scheme());
+    if (u.has_authority()) {
+        out.append("//");
+        if (auto ui = u.userinfo()) {
+            canonical_percent(*ui, out);
+            out.push_back('@');
+        }
+        bool first = true;
+        for (const auto& hp : u.hosts()) {
+            if (!first) out.push_back(',');
+            first = false;
+            canonical_host(hp.host, out);
+            if (hp.port && hp.port != implied) {
+                char   buf[6];
+                size_t n = 0;
+                for (unsigned v = *hp.port; n == 0 || v; v /= 10) buf[n++] = char('0' + v % 10);
+                out.push_back(':');
+                while (n) out.push_back(buf[--n]);
+            }
+        }
+    }
+    auto path = u.raw_path();
+    if (path.empty() && u.has_authority() && implied) {
+        out.push_back('/');
+    } else if (!has_dot_segment(path)) {
+        canonical_percent(path, out);
+    } else {
+        stack_sink<256> canon;
+        canonical_percent(path, canon);
+        out.append(std::string_view(canon.data(), remove_dot_segments(canon.data(), canon.size())));
+    }
+    if (auto q = u.raw_query()) {
+        out.push_back('?');
+        canonical_percent(*q, out);
+    }
+    if (auto f = u.fragment()) {
+        out.push_back('#');
+        canonical_percent(*f, out);
+    }
+}
+
+// upper bound of the normalized length: only re-escaped host bytes and the implied "/" grow
+inline size_t normalized_capacity(const URIView& u) {
+    size_t hosts = 0;
+    for (const auto& hp : u.hosts()) hosts += 2 * hp.host.size() + 2;
+    return u.uri().size() + hosts + 1;
+}
+
+// equal normal forms; only URIs whose normal form outgrows the stack buffer allocate
+inline bool normalized_equal(const URIView& a, const URIView& b) {
+    stack_sink<512> na;
+    normalize(a, na);
+    compare_sink cmp(na.view());
+    normalize(b, cmp);
+    return cmp.matches();
+}
+
+// URI::hash(): computed on first use. 0 means "not yet"; a hash that really is 0 is
+// simply recomputed. Relaxed is enough, every thread computes the same value.
+class cached_hash {
+   public:
+    cached_hash() = default;
+    cached_hash(const cached_hash& o) : v_(o.peek()) {}
+    cached_hash& operator=(const cached_hash& o) {
+        v_.store(o.peek(), std::memory_order_relaxed);
+        return *this;
+    }
+    template <typename F>
+    uint64_t get(F compute) const {
+        uint64_t h = peek();
+        if (!h) v_.store(h = compute(), std::memory_order_relaxed);
+        return h;
+    }
+    uint64_t peek() const { return v_.load(std::memory_order_relaxed); }
+
+   private:
+    mutable std::atomic<uint64_t> v_{0};
+};
+
+}  // namespace detail
+
+// RFC 3986 §6 normal form, written into one pre-sized allocation
+inline std::string normalize(const URIView& u) {
+    std::string out;
+    out.reserve(detail::normalized_capacity(u));
+    detail::normalize(u, out);
+    return out;
+}
+
+// Stable 64-bit hash of the normal form; equivalent URIs hash equally
+inline uint64_t normalized_hash(const URIView& u) {
+    detail::uri_hasher h;
+    detail::normalize(u, h);
+    return h.finish();
+}
+
+// Owning URI: keeps a copy of the input plus the URIView offsets into it. Hosts are
+// percent-decoded and lowercased once at construction.
+class URI final {
+   private:
+    friend class URIStreamParser;
+
+    std::string           uri_;
+    detail::uri_layout    layout_;
+    std::vector<HostPort> hosts_;
+    detail::cached_hash   hash_;
+
+   public:
+    // scheme(), raw_path(), raw_query() and fragment() return views into uri(); they used
+    // to return const std::string& / std::optional<std::string>. Copy the result into a
+    // std::string where it must outlive the URI or needs c_str().
+    const std::string& uri() const { return uri_; }
+    std::string_view   scheme() const { return layout_.scheme.in(uri_); }
+    URIView            view() const { return URIView(uri_, layout_); }
+
+    typedef std::pair<std::string, std::string> UserPass;
+    std::optional<UserPass>                     User() const {
+        if (!layout_.has_userinfo) return std::nullopt;
+        auto   a   = layout_.userinfo.in(uri_);
+        size_t pos = a.find(':');
+        if (pos == std::string_view::npos) return std::make_pair(percent_decode(a), std::string{});
+        return std::make_pair(percent_decode(a.substr(0, pos)), percent_decode(a.substr(pos + 1)));
+    }
+    const std::vector<HostPort>& hosts() const { return hosts_; }
+    std::string                  path() const { return percent_decode(raw_path()); }
+    std::string_view             raw_path() const { return layout_.path.in(uri_); }
+    std::optional<std::string>   query() const {
+        return layout_.has_query ? std::optional(percent_decode(layout_.query.in(uri_))) : std::nullopt;
+    }
+    std::optional<std::string_view> raw_query() const { return view().raw_query(); }
+    std::optional<std::string_view> fragment() const { return view().fragment(); }
+    QueryRange                      query_params() const { return view().query_params(); }
+
+    // RFC 3986 §6 normal form and its hash (computed on first use, then cached)
+    std::string normalized() const { return normalize(view()); }
+    uint64_t    hash() const {
+        return hash_.get([this] { return normalized_hash(view()); });
+    }
+    // equivalent after normalization; compares the streamed normal forms without building them
+    bool operator==(const URI& o) const {
+        if (uri_ == o.uri_) return true;
+        uint64_t a = hash_.peek(), b = o.hash_.peek();
+        if (a && b && a != b) return false;
+        return detail::normalized_equal(view(), o.view());
+    }
+
+    // Parse and return a URI object. Throws parse_error on invalid input
+    URI(std::string input, parse_mode mode = parse_mode::lenient) : uri_(std::move(input)) {
+        if (auto err = detail::parse_layout(uri_, layout_, mode)) throw parse_error(err);
+        init_hosts();
+    }
+
+    // Non-throwing parse; invalid input is rejected before anything is copied
+    static parse_result<URI> try_parse(std::string_view input, parse_mode mode = parse_mode::lenient) {
+        detail::uri_layout layout;
+        if (auto err = detail::parse_layout(input, layout, mode)) return err;
+        return URI(std::string(input), layout);
+    }
+
+    // percent-decode a string -> std::string (one allocation)
+    static std::string percent_decode(std::string_view in) {
+        std::string str(in.size(), '\0');
+        str.resize(detail::percent_decode_to(in, str.data()));
         return str;
     }
 
-    static std::string percent_encode(const std::string& in, const std::string& allowed = "") {
+    // Decode into a caller buffer; nullopt if `out` is smaller than `in`.
+    // Returns the decoded bytes as a view into `out`.
+    static std::optional<std::string_view> percent_decode(std::string_view in, std::span<char> out) {
+        if (out.size() < in.size()) return std::nullopt;
+        return std::string_view(out.data(), detail::percent_decode_to(in, out.data()));
+    }
+
+    // Decode in place; returns the new length (never longer than before).
+    static size_t percent_decode_inplace(std::span<char> buf) {
+        return detail::percent_decode_to(std::string_view(buf.data(), buf.size()), buf.data());
+    }
+    static void percent_decode_inplace(std::string& s) {
+        s.resize(detail::percent_decode_to(s, s.data()));
+    }
+
+    // Escape every byte that is neither unreserved nor listed in `allowed`
+    static std::string percent_encode(std::string_view in, std::string_view allowed = {}) {
+        detail::byte_set keep = detail::kUnreserved;
+        keep.add(allowed);
+        return percent_encode(in, keep);
+    }
+    static std::string percent_encode(std::string_view in, const detail::byte_set& keep) {
         std::string out;
         out.reserve(in.size());
-        for (unsigned char c : in) {
-            if (is_unreserved(c) || allowed.find(c) != std::string::npos) {
-                out.push_back(static_cast<char>(c));
-            } else {
-                out.push_back('%');
-                out.push_back(hex_digit((c >> 4) & 0xF));
-                out.push_back(hex_digit(c & 0xF));
-            }
-        }
+        detail::percent_encode_to(in, keep, out);
         return out;
     }
 
     std::string to_string() const {
         std::string str;
-        str.append(scheme_);
+        // only unbracketed IPv6 hosts gain characters
+        str.reserve(uri_.size() + 2 * hosts_.size());
+        str.append(scheme());
         str.push_back(':');
-        if (has_authority_) {
+        if (layout_.has_authority) {
             str.append("//");
-            if (authority_) {
-                str.append(*authority_);
+            if (layout_.has_userinfo) {
+                str.append(layout_.userinfo.in(uri_));
                 str.push_back('@');
             }
             for (size_t k = 0; k < hosts_.size(); ++k) {
                 if (k) str.push_back(',');
-                str.append(hosts_[k].to_string());
+                hosts_[k].append_to(str);
             }
         }
 
-        str.append(path_);
-        if (query_) {
+        str.append(raw_path());
+        if (layout_.has_query) {
             str.push_back('?');
-            str.append(*query_);
+            str.append(layout_.query.in(uri_));
         }
-        if (fragment_) {
+        if (layout_.has_fragment) {
             str.push_back('#');
-            str.append(*fragment_);
+            str.append(layout_.fragment.in(uri_));
         }
         return str;
     }
 
    private:
-    // helper functions
-    static inline bool is_hex(char c) { return std::isxdigit((unsigned char)c); }
-    static inline int  hex_val(char c) {
-        if (c >= '0' && c <= '9') return c - '0';
-        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
-        return c - 'A' + 10;
-    }
-    static inline char hex_digit(int v) {
-        const char* H = "0123456789ABCDEF";
-        return H[v & 0xF];
-    }
-    static inline bool is_unreserved(unsigned char c) {
-        return std::isalnum(c) || c == '-' || c == '.' || c == '_' || c == '~';
-    }
-
-    // trim spaces (in-place for string via slicing)
-    inline void trim_space(std::string& v) {
-        size_t b = 0;
-        while (b < v.size() && std::isspace((unsigned char)v[b])) ++b;
-        size_t e = v.size();
-        while (e > b && std::isspace((unsigned char)v[e - 1])) --e;
-        v = v.substr(b, e - b);
-    }
-
-    // parse hostport from a string
-    HostPort parse_hostport(std::string item) {
-        HostPort hp;
-        trim_space(item);
-        if (item.empty()) throw parse_error("empty host item");
-        if (item.size() > 0 && item[0] == '[') {
-            // IPv6 literal
-            size_t rb = item.find(']');
-            if (rb == std::string::npos) throw parse_error("unclosed IPv6 bracket");
-            hp.host = item.substr(1, rb - 1);
-            if (rb + 1 == item.size()) return hp;
-            if (item[rb + 1] != ':') throw parse_error("unexpected chars after IPv6 literal");
-            auto portstr = item.substr(rb + 2);
-            if (portstr.empty()) throw parse_error("empty port");
-            hp.port = parse_port(portstr);
-            return hp;
-        }
-        size_t colon = item.rfind(':');
-        if (colon == std::string::npos) {
-            hp.host = item;
-            return hp;
-        }
-        // if multiple ':' present and not bracketed, treat as host
-        // (non-bracketed IPv6) to avoid misparse
-        if (item.find(':') != colon) {
-            hp.host = item;
-            return hp;
-        }
-        hp.host      = item.substr(0, colon);
-        auto portstr = item.substr(colon + 1);
-        if (portstr.empty()) throw parse_error("empty port");
-        hp.port = parse_port(portstr);
-        return hp;
-    }
-
-    uint16_t parse_port(std::string s) {
-        if (s.size() > 1 && s[0] == '0') throw parse_error("port has leading zeros");
-        int val = 0;
-        for (char c : s) {
-            if (!std::isdigit((unsigned char)c)) throw parse_error("port contains non-digit");
-            val = val * 10 + (c - '0');
-            if (val > 65535) throw parse_error("port out of range");
-        }
-        return static_cast<uint16_t>(val);
+    // input already validated by parse_layout
+    URI(std::string input, const detail::uri_layout& layout) : uri_(std::move(input)), layout_(layout) {
+        init_hosts();
+    }
+
+    // normalize host: percent-decode then lowercase
+    void init_hosts() {
+        hosts_.reserve(layout_.host_count);
+        for (const auto& v : view().hosts()) {
+            HostPort hp{percent_decode(v.host), v.port, v.ip};
+            for (auto& c : hp.host) c = detail::to_lower(c);
+            // percent-encoded digits only form an address once decoded
+            if (!hp.ip && v.host.find('%') != std::string_view::npos) hp.ip = detail::parse_ip(hp.host, false);
+            hosts_.push_back(std::move(hp));
+        }
     }
 };
 
 };  // namespace net
 };  // namespace cpptools
+
+template <>
+struct std::hash<cpptools::net::URI> {
+    size_t operator()(const cpptools::net::URI& u) const noexcept { return u.hash(); }
+};
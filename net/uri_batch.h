@@ -0,0 +1,199 @@
+// Bulk URI parsing into a struct-of-arrays result.
+//
+// All inputs are copied once into a single bump arena and parsed in place with the same
+// core as URI/URIView, optionally on several threads. Component offsets live in one
+// column per component, hosts are interned into a table shared by every row, and each
+// row carries its own error code instead of throwing.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "uri.h"
+
+namespace cpptools {
+namespace net {
+
+struct BatchOptions {
+    parse_mode mode       = parse_mode::lenient;
+    unsigned   threads    = 1;  // 0: std::thread::hardware_concurrency()
+    size_t     chunk_rows = 1024;
+};
+
+// One host of a row: index into the shared host table plus the port
+struct BatchHost {
+    uint32_t                id;
+    std::optional<uint16_t> port;
+};
+
+class URIBatch final {
+   public:
+    URIBatch() = default;
+
+    static URIBatch parse(std::span<const std::string_view> inputs, const BatchOptions& opts = {}) {
+        URIBatch b;
+        b.parse_rows(inputs, opts);
+        b.intern_hosts();
+        return b;
+    }
+
+    size_t           size() const { return errors_.size(); }
+    bool             ok(size_t row) const { return !errors_[row]; }
+    uri_error        error(size_t row) const { return errors_[row]; }
+    size_t           error_count() const { return error_count_; }
+    std::string_view input(size_t row) const {
+        return std::string_view(arena_.get() + input_pos_[row], input_len_[row]);
+    }
+
+    // Components of a row that parsed successfully (empty for failed rows)
+    std::string_view scheme(size_t row) const { return scheme_[row].in(input(row)); }
+    std::string_view raw_path(size_t row) const { return path_[row].in(input(row)); }
+    std::optional<std::string_view> raw_query(size_t row) const {
+        return flags_[row] & kQuery ? std::optional(query_[row].in(input(row))) : std::nullopt;
+    }
+    std::optional<std::string_view> fragment(size_t row) const {
+        return flags_[row] & kFragment ? std::optional(fragment_[row].in(input(row))) : std::nullopt;
+    }
+    // Full view of a row, backed by the batch's arena
+    URIView view(size_t row) const {
+        detail::uri_layout l;
+        l.scheme        = scheme_[row];
+        l.userinfo      = userinfo_[row];
+        l.hostlist      = hostlist_[row];
+        l.path          = path_[row];
+        l.query         = query_[row];
+        l.fragment      = fragment_[row];
+        l.host_count    = uint16_t(host_begin_[row + 1] - host_begin_[row]);
+        l.has_authority = flags_[row] & kAuthority;
+        l.has_userinfo  = flags_[row] & kUserinfo;
+        l.has_query     = flags_[row] & kQuery;
+        l.has_fragment  = flags_[row] & kFragment;
+        return URIView(input(row), l);
+    }
+
+    // Hosts of a row; names are percent-decoded and lowercased like URI::hosts()
+    std::span<const BatchHost> hosts(size_t row) const {
+        return std::span<const BatchHost>(hosts_.data() + host_begin_[row], host_begin_[row + 1] - host_begin_[row]);
+    }
+    size_t           host_table_size() const { return host_names_.size(); }
+    std::string_view host_name(uint32_t id) const { return host_names_[id]; }
+
+   private:
+    enum : uint8_t { kAuthority = 1, kUserinfo = 2, kQuery = 4, kFragment = 8 };
+
+    void parse_rows(std::span<const std::string_view> inputs, const BatchOptions& opts) {
+        const size_t n = inputs.size();
+        input_pos_.resize(n);
+        input_len_.resize(n);
+        size_t total = 0;
+        for (size_t r = 0; r < n; ++r) {
+            input_pos_[r] = total;
+            input_len_[r] = uint32_t(std::min<size_t>(inputs[r].size(), UINT32_MAX));
+            total += input_len_[r];
+        }
+        arena_.reset(new char[std::max<size_t>(total, 1)]);
+        for (auto* col : {&scheme_, &userinfo_, &hostlist_, &path_, &query_, &fragment_}) col->resize(n);
+        flags_.resize(n);
+        errors_.resize(n);
+        host_counts_.assign(n, 0);
+
+        // rows are independent, so workers only ever write their own slots
+        std::atomic<size_t> next{0};
+        const size_t        chunk = std::max<size_t>(opts.chunk_rows, 1);
+        auto                work  = [&] {
+            for (size_t b; (b = next.fetch_add(chunk, std::memory_order_relaxed)) < n;)
+                for (size_t r = b; r < std::min(b + chunk, n); ++r) parse_row(r, inputs[r], opts.mode);
+        };
+
+        unsigned threads = opts.threads ? opts.threads : std::max(1u, std::thread::hardware_concurrency());
+        threads          = unsigned(std::min<size_t>(threads, (n + chunk - 1) / chunk));
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < threads; ++t) pool.emplace_back(work);
+        work();
+        for (auto& t : pool) t.join();
+
+        for (const auto& e : errors_) error_count_ += bool(e);
+    }
+
+    void parse_row(size_t r, std::string_view in, parse_mode mode) {
+        char* dst = arena_.get() + input_pos_[r];
+        std::memcpy(dst, in.data(), input_len_[r]);
+
+        detail::uri_layout l;
+        if (in.size() > UINT32_MAX) {
+            errors_[r] = uri_error{uri_errc::input_too_long, UINT32_MAX};
+            return;
+        }
+        if (auto err = detail::parse_layout(std::string_view(dst, input_len_[r]), l, mode)) {
+            errors_[r] = err;
+            return;
+        }
+        scheme_[r]      = l.scheme;
+        userinfo_[r]    = l.userinfo;
+        hostlist_[r]    = l.hostlist;
+        path_[r]        = l.path;
+        query_[r]       = l.query;
+        fragment_[r]    = l.fragment;
+        flags_[r]       = uint8_t((l.has_authority ? kAuthority : 0) | (l.has_userinfo ? kUserinfo : 0) |
+                            (l.has_query ? kQuery : 0) | (l.has_fragment ? kFragment : 0));
+        host_counts_[r] = l.host_count;
+    }
+
+    // Sequential: decode every host once into the host arena and intern it
+    void intern_hosts() {
+        const size_t n = size();
+        host_begin_.resize(n + 1);
+        size_t total = 0, bytes = 0;
+        for (size_t r = 0; r < n; ++r) {
+            host_begin_[r] = uint32_t(total);
+            total += host_counts_[r];
+            bytes += hostlist_[r].len;
+        }
+        host_begin_[n] = uint32_t(total);
+        host_counts_   = {};
+        hosts_.reserve(total);
+        // decoded names are never longer than the raw host lists, so views stay stable
+        host_arena_.reset(new char[std::max<size_t>(bytes, 1)]);
+
+        std::unordered_map<std::string_view, uint32_t> ids;
+        size_t                                         used = 0;
+        for (size_t r = 0; r < n; ++r) {
+            if (host_begin_[r] == host_begin_[r + 1]) continue;
+            for (const auto& hp : view(r).hosts()) {
+                char*  name = host_arena_.get() + used;
+                size_t len  = detail::percent_decode_to(hp.host, name);
+                for (size_t k = 0; k < len; ++k) name[k] = detail::to_lower(name[k]);
+                auto [it, inserted] = ids.try_emplace(std::string_view(name, len), uint32_t(host_names_.size()));
+                if (inserted) {
+                    host_names_.push_back(it->first);
+                    used += len;
+                }
+                hosts_.push_back(BatchHost{it->second, hp.port});
+            }
+        }
+    }
+
+    std::unique_ptr<char[]>   arena_;
+    std::vector<uint64_t>     input_pos_;
+    std::vector<uint32_t>     input_len_;
+    std::vector<detail::span> scheme_, userinfo_, hostlist_, path_, query_, fragment_;
+    std::vector<uint8_t>      flags_;
+    std::vector<uri_error>    errors_;
+    std::vector<uint16_t>     host_counts_;
+    size_t                    error_count_ = 0;
+
+    std::vector<uint32_t>         host_begin_;  // row -> first index into hosts_, size() + 1 entries
+    std::vector<BatchHost>        hosts_;
+    std::unique_ptr<char[]>       host_arena_;
+    std::vector<std::string_view> host_names_;
+};
+
+};  // namespace net
+};  // namespace cpptools
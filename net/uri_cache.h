@@ -0,0 +1,159 @@
+// Cache of parsed URIs keyed by their raw input bytes.
+//
+// Hot services see the same connection strings and request targets over and over; the
+// cache hands out one immutable shared URI per distinct input instead of reparsing it.
+// Entries are spread over independently locked shards, each with its own LRU list, and
+// both the entry count and the approximate memory footprint are bounded. A hit only
+// splices a list node and copies a shared_ptr, so it never allocates.
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "uri.h"
+
+namespace cpptools {
+namespace net {
+
+struct URICacheOptions {
+    size_t     max_entries = 4096;  // total over all shards
+    size_t     max_bytes   = 0;     // approximate memory budget, 0 = unbounded
+    size_t     shards      = 16;
+    parse_mode mode        = parse_mode::lenient;
+};
+
+struct URICacheStats {
+    uint64_t hits      = 0;
+    uint64_t misses    = 0;
+    uint64_t evictions = 0;
+    uint64_t failures  = 0;  // misses whose input did not parse (never cached)
+    size_t   entries   = 0;
+    size_t   bytes     = 0;
+};
+
+class URICache final {
+   public:
+    using pointer = std::shared_ptr<const URI>;
+
+    // Never more shards than entries, so the per-shard limits add up to max_entries
+    explicit URICache(const URICacheOptions& opts = {})
+        : opts_(opts), shards_(std::clamp<size_t>(opts.shards, 1, std::max<size_t>(opts.max_entries, 1))) {
+        const size_t n = shards_.size();
+        for (size_t i = 0; i < n; ++i) {
+            shards_[i].max_entries = std::max<size_t>(opts_.max_entries / n + (i < opts_.max_entries % n), 1);
+            shards_[i].max_bytes   = opts_.max_bytes / n;
+        }
+    }
+
+    URICache(const URICache&)            = delete;
+    URICache& operator=(const URICache&) = delete;
+
+    // Cached parse of `input`; invalid input is reported, not cached
+    parse_result<pointer> try_get(std::string_view input) {
+        const size_t h = std::hash<std::string_view>{}(input);
+        shard&       s = shards_[h % shards_.size()];
+        {
+            std::lock_guard<std::mutex> lk(s.mu);
+            if (auto it = s.index.find(input); it != s.index.end()) {
+                s.lru.splice(s.lru.begin(), s.lru, it->second);
+                ++s.stats.hits;
+                return it->second->uri;
+            }
+            ++s.stats.misses;
+        }
+
+        // parse outside the lock; concurrent misses on one key may both parse
+        auto parsed = URI::try_parse(input, opts_.mode);
+        if (!parsed) {
+            std::lock_guard<std::mutex> lk(s.mu);
+            ++s.stats.failures;
+            return parsed.error();
+        }
+        auto   uri  = std::make_shared<const URI>(std::move(*parsed));
+        size_t cost = entry_cost(*uri);
+
+        std::lock_guard<std::mutex> lk(s.mu);
+        if (auto it = s.index.find(input); it != s.index.end()) {
+            s.lru.splice(s.lru.begin(), s.lru, it->second);  // another thread cached it meanwhile
+            return it->second->uri;
+        }
+        s.lru.push_front(entry{std::string(input), uri, cost});
+        s.index.emplace(s.lru.front().key, s.lru.begin());
+        s.stats.bytes += cost;
+        evict(s);
+        return uri;
+    }
+
+    // Throws parse_error on invalid input
+    pointer get(std::string_view input) { return try_get(input).value(); }
+
+    URICacheStats stats() const {
+        URICacheStats total;
+        for (const auto& s : shards_) {
+            std::lock_guard<std::mutex> lk(s.mu);
+            total.hits += s.stats.hits;
+            total.misses += s.stats.misses;
+            total.evictions += s.stats.evictions;
+            total.failures += s.stats.failures;
+            total.entries += s.index.size();
+            total.bytes += s.stats.bytes;
+        }
+        return total;
+    }
+
+    void clear() {
+        for (auto& s : shards_) {
+            std::lock_guard<std::mutex> lk(s.mu);
+            s.index.clear();
+            s.lru.clear();
+            s.stats.bytes = 0;
+        }
+    }
+
+   private:
+    struct entry {
+        std::string key;
+        pointer     uri;
+        size_t      cost;
+    };
+
+    struct shard {
+        mutable std::mutex                                               mu;
+        std::list<entry>                                                 lru;    // front = most recent
+        std::unordered_map<std::string_view, std::list<entry>::iterator> index;  // keys view entry::key
+        URICacheStats                                                    stats;
+        size_t                                                           max_entries = 0;
+        size_t                                                           max_bytes   = 0;
+    };
+
+    // rough heap footprint of one cached entry
+    static size_t entry_cost(const URI& u) {
+        size_t cost = sizeof(entry) + sizeof(URI) + 4 * sizeof(void*) + 2 * u.uri().size();
+        for (const auto& hp : u.hosts()) cost += sizeof(HostPort) + hp.host.size();
+        return cost;
+    }
+
+    static void evict(shard& s) {
+        while (s.index.size() > s.max_entries || (s.max_bytes && s.stats.bytes > s.max_bytes && s.index.size() > 1)) {
+            auto& victim = s.lru.back();
+            s.stats.bytes -= victim.cost;
+            s.index.erase(victim.key);
+            s.lru.pop_back();
+            ++s.stats.evictions;
+        }
+    }
+
+    const URICacheOptions opts_;
+    std::vector<shard>    shards_;
+};
+
+};  // namespace net
+};  // namespace cpptools
@@ -0,0 +1,349 @@
+// Typed, declarative decoding of connection-string options.
+//
+// Drivers describe their query options once, as a constexpr schema that binds each option
+// name to a member of a plain struct:
+//
+//     struct MongoOptions {
+//         std::chrono::milliseconds timeout{30000};
+//         int                       maxPoolSize = 100;
+//         std::string               replicaSet;
+//         std::optional<bool>       tls;
+//         size_t                    bufferSize = 0;
+//     };
+//     constexpr auto kMongoSchema = make_option_schema<MongoOptions>(
+//         option("timeout", &MongoOptions::timeout, 5s),
+//         option("maxPoolSize", &MongoOptions::maxPoolSize),
+//         option("replicaSet", &MongoOptions::replicaSet),
+//         option("tls", &MongoOptions::tls),
+//         size_option("bufferSize", &MongoOptions::bufferSize, 64 * 1024));
+//
+//     auto res = kMongoSchema.decode(uri);  // res.value, res.errors
+//
+// decode() walks the raw query once. Values are percent-decoded into a stack buffer,
+// and only std::string members allocate; other values over 64 bytes go to the heap.
+// Supported member types are bool, integers, floating point, std::string,
+// std::chrono::duration and std::optional of any of them.
+// Durations take a unit suffix (ns, us, ms, s, m, h, d); a bare number is in the
+// member's own unit. Size options accept B, kB/MB/GB (powers of 1000) and
+// K/M/G, KiB/MiB/GiB (powers of 1024). Unknown options and bad values are collected
+// into `errors` rather than thrown. A repeated option keeps its last valid value.
+
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "uri.h"
+
+namespace cpptools {
+namespace net {
+
+enum class option_errc : uint8_t {
+    ok = 0,
+    unknown_option,
+    missing_value,  // "key" without '=' for a non-bool option
+    invalid_value,
+    out_of_range,
+    bad_unit,
+};
+
+constexpr const char* to_string(option_errc e) {
+    switch (e) {
+        case option_errc::ok: return "ok";
+        case option_errc::unknown_option: return "unknown option";
+        case option_errc::missing_value: return "missing value";
+        case option_errc::invalid_value: return "invalid value";
+        case option_errc::out_of_range: return "value out of range";
+        case option_errc::bad_unit: return "unknown unit";
+    }
+    return "unknown error";
+}
+
+// One rejected query parameter; key and value are raw views into the query
+struct OptionError {
+    option_errc      code;
+    std::string_view key;
+    std::string_view value;
+
+    const char* message() const { return to_string(code); }
+    bool        operator==(const OptionError& o) const = default;
+};
+
+template <class S>
+struct OptionsResult {
+    S                        value{};
+    std::vector<OptionError> errors;
+
+    bool ok() const { return errors.empty(); }
+};
+
+namespace detail {
+
+template <class T>
+struct is_duration : std::false_type {};
+template <class R, class P>
+struct is_duration<std::chrono::duration<R, P>> : std::true_type {};
+
+template <class T>
+struct is_optional : std::false_type {};
+template <class T>
+struct is_optional<std::optional<T>> : std::true_type {};
+
+template <class T>
+struct unwrap_optional {
+    using type = T;
+};
+template <class T>
+struct unwrap_optional<std::optional<T>> {
+    using type = T;
+};
+
+// type a schema default is given as: std::string defaults are string literals so
+// the schema itself stays a literal type
+template <class M>
+using option_default_t = std::conditional_t<std::is_same_v<typename unwrap_optional<M>::type, std::string>,
+                                            std::string_view, typename unwrap_optional<M>::type>;
+
+// leading number and trailing unit of "1.5s", "64KiB", ...
+constexpr void split_unit(std::string_view v, std::string_view& num, std::string_view& unit) {
+    size_t k = 0;
+    while (k < v.size() && (is_digit(v[k]) || v[k] == '.' || v[k] == '-' || v[k] == '+')) ++k;
+    num  = v.substr(0, k);
+    unit = v.substr(k);
+}
+
+inline option_errc parse_number(std::string_view v, double& out) {
+    if (v.empty() || v[0] == '+') return option_errc::invalid_value;
+    auto [p, ec] = std::from_chars(v.data(), v.data() + v.size(), out);
+    if (ec == std::errc::result_out_of_range) return option_errc::out_of_range;
+    if (ec != std::errc() || p != v.data() + v.size() || !std::isfinite(out)) return option_errc::invalid_value;
+    return option_errc::ok;
+}
+
+template <class I>
+option_errc parse_integer(std::string_view v, I& out) {
+    if (v.empty() || v[0] == '+') return option_errc::invalid_value;
+    auto [p, ec] = std::from_chars(v.data(), v.data() + v.size(), out);
+    if (ec == std::errc::result_out_of_range) return option_errc::out_of_range;
+    if (ec != std::errc() || p != v.data() + v.size()) return option_errc::invalid_value;
+    return option_errc::ok;
+}
+
+constexpr option_errc parse_bool(std::string_view v, bool& out) {
+    for (std::string_view t : {"true", "1", "yes", "on"}) {
+        if (iequals(v, t)) {
+            out = true;
+            return option_errc::ok;
+        }
+    }
+    for (std::string_view f : {"false", "0", "no", "off"}) {
+        if (iequals(v, f)) {
+            out = false;
+            return option_errc::ok;
+        }
+    }
+    return option_errc::invalid_value;
+}
+
+// scaled value -> integral type, with range check
+template <class I>
+option_errc to_integral(double v, I& out) {
+    v = std::round(v);
+    if (v < double(std::numeric_limits<I>::min()) || v >= double(std::numeric_limits<I>::max()) + 1.0)
+        return option_errc::out_of_range;
+    out = I(v);
+    return option_errc::ok;
+}
+
+template <class D>
+option_errc parse_duration(std::string_view v, D& out) {
+    std::string_view num, unit;
+    split_unit(v, num, unit);
+    double x = 0;
+    if (auto err = parse_number(num, x); err != option_errc::ok) return err;
+    if (x < 0) return option_errc::out_of_range;
+    // seconds per unit; a bare number counts in D's own period
+    constexpr std::pair<std::string_view, double> kUnits[] = {
+        {"ns", 1e-9}, {"us", 1e-6}, {"ms", 1e-3}, {"s", 1}, {"m", 60}, {"min", 60}, {"h", 3600}, {"d", 86400},
+    };
+    double secs = x * double(D::period::num) / double(D::period::den);
+    if (!unit.empty()) {
+        const auto* u =
+            std::find_if(std::begin(kUnits), std::end(kUnits), [&](auto& k) { return iequals(unit, k.first); });
+        if (u == std::end(kUnits)) return option_errc::bad_unit;
+        secs = x * u->second;
+    }
+    typename D::rep ticks{};
+    if constexpr (std::is_floating_point_v<typename D::rep>) {
+        ticks = typename D::rep(secs * double(D::period::den) / double(D::period::num));
+    } else {
+        if (auto err = to_integral(secs * double(D::period::den) / double(D::period::num), ticks);
+            err != option_errc::ok)
+            return err;
+    }
+    out = D(ticks);
+    return option_errc::ok;
+}
+
+template <class I>
+option_errc parse_size(std::string_view v, I& out) {
+    std::string_view num, unit;
+    split_unit(v, num, unit);
+    double x = 0;
+    if (auto err = parse_number(num, x); err != option_errc::ok) return err;
+    if (x < 0) return option_errc::out_of_range;
+    constexpr double                              k        = 1024;
+    constexpr std::pair<std::string_view, double> kUnits[] = {
+        {"b", 1},        {"kb", 1e3},         {"mb", 1e6},             {"gb", 1e9},                 {"tb", 1e12},
+        {"k", k},        {"m", k * k},        {"g", k * k * k},        {"t", k * k * k * k},        //
+        {"kib", k},      {"mib", k * k},      {"gib", k * k * k},      {"tib", k * k * k * k},
+    };
+    double scale = 1;
+    if (!unit.empty()) {
+        const auto* u =
+            std::find_if(std::begin(kUnits), std::end(kUnits), [&](auto& k) { return iequals(unit, k.first); });
+        if (u == std::end(kUnits)) return option_errc::bad_unit;
+        scale = u->second;
+    }
+    return to_integral(x * scale, out);
+}
+
+// Decode one raw value into a member. Only std::string members and long values allocate.
+template <class M>
+option_errc decode_option(const QueryParam& p, bool bytes, M& out) {
+    using T = typename unwrap_optional<M>::type;
+    if constexpr (is_optional<M>::value) {
+        T v{};
+        auto err = decode_option(p, bytes, v);
+        if (err == option_errc::ok) out = std::move(v);
+        return err;
+    } else if constexpr (std::is_same_v<T, std::string>) {
+        if (!p.has_value) return option_errc::missing_value;
+        out = p.decoded_value();
+        return option_errc::ok;
+    } else {
+        if (!p.has_value) {
+            // a bare flag turns a bool option on
+            if constexpr (std::is_same_v<T, bool>) {
+                out = true;
+                return option_errc::ok;
+            }
+            return option_errc::missing_value;
+        }
+        // scalars fit on the stack; a longer value (zero padding, say) still gets parsed
+        char        buf[64];
+        std::string heap;
+        char*       dst = buf;
+        if (p.value.size() > sizeof(buf)) {
+            heap.resize(p.value.size());
+            dst = heap.data();
+        }
+        std::string_view v(dst, percent_decode_to(p.value, dst));
+        if constexpr (std::is_same_v<T, bool>)
+            return parse_bool(v, out);
+        else if constexpr (is_duration<T>::value)
+            return parse_duration(v, out);
+        else if constexpr (std::is_integral_v<T>)
+            return bytes ? parse_size(v, out) : parse_integer(v, out);
+        else if constexpr (std::is_floating_point_v<T>) {
+            double x = 0;
+            auto   err = parse_number(v, x);
+            if (err == option_errc::ok) out = T(x);
+            return err;
+        } else
+            static_assert(!sizeof(T), "unsupported option member type");
+    }
+}
+
+}  // namespace detail
+
+// One schema entry: query name -> member of S
+template <class S, class M>
+struct Option {
+    using member_type = M;
+
+    std::string_view            name;
+    M S::*                      member;
+    bool                        has_default = false;
+    detail::option_default_t<M> def{};
+    bool                        bytes = false;  // integer with a size unit
+};
+
+template <class S, class M>
+constexpr Option<S, M> option(std::string_view name, M S::*member) {
+    return {name, member};
+}
+template <class S, class M>
+constexpr Option<S, M> option(std::string_view name, M S::*member, detail::option_default_t<M> def) {
+    return {name, member, true, def};
+}
+template <class S, class M>
+    requires std::is_integral_v<typename detail::unwrap_optional<M>::type>
+constexpr Option<S, M> size_option(std::string_view name, M S::*member) {
+    return {name, member, false, {}, true};
+}
+template <class S, class M>
+    requires std::is_integral_v<typename detail::unwrap_optional<M>::type>
+constexpr Option<S, M> size_option(std::string_view name, M S::*member, detail::option_default_t<M> def) {
+    return {name, member, true, def, true};
+}
+
+template <class S, class... Opts>
+class OptionSchema final {
+   public:
+    constexpr explicit OptionSchema(Opts... opts) : opts_(opts...) {}
+
+    static constexpr size_t size() { return sizeof...(Opts); }
+
+    // Start from `out` (after applying schema defaults) and apply every parameter of `q`
+    std::vector<OptionError> decode_into(const QueryRange& q, S& out) const {
+        std::apply([&](const auto&... o) { (apply_default(o, out), ...); }, opts_);
+        std::vector<OptionError> errors;
+        for (const auto& p : q) {
+            option_errc err = option_errc::unknown_option;
+            std::apply([&](const auto&... o) { (try_option(o, p, out, err) || ...); }, opts_);
+            if (err != option_errc::ok) errors.push_back(OptionError{err, p.key, p.value});
+        }
+        return errors;
+    }
+
+    OptionsResult<S> decode(const QueryRange& q) const {
+        OptionsResult<S> r;
+        r.errors = decode_into(q, r.value);
+        return r;
+    }
+    OptionsResult<S> decode(const URIView& uri) const { return decode(uri.query_params()); }
+    OptionsResult<S> decode(const URI& uri) const { return decode(uri.query_params()); }
+
+   private:
+    template <class M>
+    static void apply_default(const Option<S, M>& o, S& out) {
+        if (o.has_default) out.*o.member = M(o.def);
+    }
+
+    template <class M>
+    static bool try_option(const Option<S, M>& o, const QueryParam& p, S& out, option_errc& err) {
+        if (!p.key_is(o.name)) return false;
+        err = detail::decode_option(p, o.bytes, out.*o.member);
+        return true;
+    }
+
+    std::tuple<Opts...> opts_;
+};
+
+template <class S, class... Opts>
+constexpr OptionSchema<S, Opts...> make_option_schema(Opts... opts) {
+    return OptionSchema<S, Opts...>(opts...);
+}
+
+};  // namespace net
+};  // namespace cpptools
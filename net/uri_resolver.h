@@ -0,0 +1,242 @@
+// Concurrent name resolution for the host lists of multi-host URIs.
+//
+// HostResolver resolves every host of a URI at once on a small worker pool and returns
+// ready-to-connect socket addresses in host-list order. IP literals skip the lookup
+// entirely. Results are cached per name: successes for `ttl`, failures for `negative_ttl`,
+// so a reconnect storm against a dead name does not hammer the system resolver.
+// Concurrent requests for a name already being looked up wait for that lookup instead of
+// starting their own.
+
+#pragma once
+
+#include <netdb.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "uri.h"
+
+namespace cpptools {
+namespace net {
+
+struct ResolverOptions {
+    unsigned                  threads      = 4;
+    std::chrono::milliseconds ttl          = std::chrono::seconds(30);
+    std::chrono::milliseconds negative_ttl = std::chrono::seconds(5);
+    size_t                    max_entries  = 1024;  // 0 disables caching
+    int                       family       = AF_UNSPEC;  // or AF_INET / AF_INET6
+    // Name lookup; fills addresses with port 0 and returns 0 or an EAI_* code. Defaults to
+    // getaddrinfo. An exception counts as EAI_FAIL.
+    std::function<int(const std::string& name, int family, std::vector<SockAddr>& out)> lookup;
+};
+
+struct ResolverStats {
+    uint64_t lookups   = 0;  // calls into the lookup function
+    uint64_t hits      = 0;  // answered from the cache, failures included
+    uint64_t coalesced = 0;  // joined a lookup already in flight
+    size_t   entries   = 0;
+};
+
+struct ResolvedHost {
+    HostPort              host;
+    std::vector<SockAddr> addrs;      // port filled in, ready to connect()
+    int                   error = 0;  // EAI_* code from the lookup
+
+    bool        ok() const { return error == 0 && !addrs.empty(); }
+    const char* message() const { return error ? gai_strerror(error) : "ok"; }
+};
+
+class HostResolver final {
+   public:
+    explicit HostResolver(const ResolverOptions& opts = {}) : opts_(opts) {
+        if (!opts_.lookup) opts_.lookup = system_lookup;
+        for (unsigned t = 0; t < std::max(opts_.threads, 1u); ++t) workers_.emplace_back([this] { work(); });
+    }
+
+    ~HostResolver() {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : workers_) t.join();
+    }
+
+    HostResolver(const HostResolver&)            = delete;
+    HostResolver& operator=(const HostResolver&) = delete;
+
+    // Resolve every host of `uri` concurrently. Hosts without a port get `default_port`,
+    // or the scheme's well-known port when that is 0.
+    std::vector<ResolvedHost> resolve(const URI& uri, uint16_t default_port = 0) {
+        if (!default_port) default_port = detail::default_port(uri.scheme()).value_or(0);
+        return resolve(std::span<const HostPort>(uri.hosts()), default_port);
+    }
+
+    std::vector<ResolvedHost> resolve(std::span<const HostPort> hosts, uint16_t default_port = 0) {
+        // start every lookup before waiting on any of them
+        std::vector<std::shared_future<result_ptr>> pending(hosts.size());
+        for (size_t i = 0; i < hosts.size(); ++i)
+            if (!hosts[i].ip) pending[i] = lookup(hosts[i].host);
+
+        std::vector<ResolvedHost> out(hosts.size());
+        for (size_t i = 0; i < hosts.size(); ++i) {
+            const HostPort& hp   = hosts[i];
+            uint16_t        port = hp.port.value_or(default_port);
+            out[i].host          = hp;
+            if (hp.ip) {
+                if (auto sa = hp.sockaddr(port))
+                    out[i].addrs.push_back(*sa);
+                else
+                    out[i].error = EAI_NONAME;  // unknown zone id
+                continue;
+            }
+            const result_ptr& r = pending[i].get();
+            out[i].error        = r->error;
+            out[i].addrs        = r->addrs;
+            for (auto& sa : out[i].addrs) set_port(sa, port);
+        }
+        return out;
+    }
+
+    ResolverStats stats() const {
+        std::lock_guard<std::mutex> lk(mu_);
+        ResolverStats               s = stats_;
+        s.entries                     = cache_.size();
+        return s;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lk(mu_);
+        cache_.clear();
+    }
+
+   private:
+    using clock = std::chrono::steady_clock;
+
+    struct result {
+        std::vector<SockAddr> addrs;
+        int                   error = 0;
+    };
+    using result_ptr = std::shared_ptr<const result>;
+
+    struct entry {
+        std::shared_future<result_ptr> value;  // the lookup's own future, so hits share it
+        clock::time_point              expires;
+    };
+
+    std::shared_future<result_ptr> lookup(const std::string& name) {
+        std::unique_lock<std::mutex> lk(mu_);
+        if (auto it = cache_.find(name); it != cache_.end()) {
+            if (clock::now() < it->second.expires) {
+                ++stats_.hits;
+                return it->second.value;
+            }
+            cache_.erase(it);
+        }
+        if (auto it = inflight_.find(name); it != inflight_.end()) {
+            ++stats_.coalesced;
+            return it->second;
+        }
+        auto job = std::make_shared<std::packaged_task<result_ptr()>>([this, name] { return run_lookup(name); });
+        auto fut = job->get_future().share();
+        inflight_.emplace(name, fut);
+        queue_.emplace_back([job] { (*job)(); });
+        lk.unlock();
+        cv_.notify_one();
+        return fut;
+    }
+
+    // worker side: query the system, then publish to the cache before waking waiters.
+    // A throwing lookup counts as EAI_FAIL so the in-flight entry never outlives the call.
+    // The cache keeps the in-flight future; it becomes ready as soon as this returns.
+    result_ptr run_lookup(const std::string& name) {
+        auto r = std::make_shared<result>();
+        try {
+            r->error = opts_.lookup(name, opts_.family, r->addrs);
+        } catch (...) {
+            r->addrs.clear();
+            r->error = EAI_FAIL;
+        }
+        if (!r->error && r->addrs.empty()) r->error = EAI_NONAME;
+
+        std::lock_guard<std::mutex> lk(mu_);
+        ++stats_.lookups;
+        auto node = inflight_.extract(name);
+        if (opts_.max_entries == 0) return r;
+        auto now = clock::now();
+        if (cache_.size() >= opts_.max_entries) evict(now);
+        cache_[name] = entry{std::move(node.mapped()), now + (r->error ? opts_.negative_ttl : opts_.ttl)};
+        return r;
+    }
+
+    // drop expired entries; if that frees nothing, drop the one closest to expiring
+    void evict(clock::time_point now) {
+        std::erase_if(cache_, [now](const auto& kv) { return kv.second.expires <= now; });
+        if (cache_.size() < opts_.max_entries || cache_.empty()) return;
+        auto by_expiry = [](const auto& a, const auto& b) { return a.second.expires < b.second.expires; };
+        cache_.erase(std::min_element(cache_.begin(), cache_.end(), by_expiry));
+    }
+
+    void work() {
+        for (;;) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lk(mu_);
+                cv_.wait(lk, [this] { return stop_ || !queue_.empty(); });
+                if (queue_.empty()) return;
+                job = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            job();
+        }
+    }
+
+    static void set_port(SockAddr& sa, uint16_t port) {
+        if (sa.family() == AF_INET)
+            reinterpret_cast<sockaddr_in*>(&sa.storage)->sin_port = htons(port);
+        else if (sa.family() == AF_INET6)
+            reinterpret_cast<sockaddr_in6*>(&sa.storage)->sin6_port = htons(port);
+    }
+
+    static int system_lookup(const std::string& name, int family, std::vector<SockAddr>& out) {
+        addrinfo hints{};
+        hints.ai_family   = family;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* res     = nullptr;
+        if (int rc = getaddrinfo(name.c_str(), nullptr, &hints, &res)) return rc;
+        for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+            if (ai->ai_addrlen > sizeof(sockaddr_storage)) continue;
+            SockAddr sa;
+            std::memcpy(&sa.storage, ai->ai_addr, ai->ai_addrlen);
+            sa.len = ai->ai_addrlen;
+            out.push_back(sa);
+        }
+        freeaddrinfo(res);
+        return 0;
+    }
+
+    ResolverOptions opts_;
+
+    mutable std::mutex                                              mu_;
+    std::condition_variable                                         cv_;
+    std::deque<std::function<void()>>                               queue_;
+    std::unordered_map<std::string, entry>                          cache_;
+    std::unordered_map<std::string, std::shared_future<result_ptr>> inflight_;
+    ResolverStats                                                   stats_;
+    bool                                                            stop_ = false;
+    std::vector<std::thread>                                        workers_;
+};
+
+};  // namespace net
+};  // namespace cpptools
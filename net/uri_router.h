@@ -0,0 +1,268 @@
+// Compiled path router: matches a raw URI path against a table of route templates.
+//
+// Templates are '/'-separated segments. A segment is static text, a parameter "{name}"
+// that captures one non-empty segment, or, last only, a wildcard "{*name}" that captures
+// the rest of the path. Routes go into a Builder, which compiles them into an immutable
+// radix trie. Chains of static segments collapse into one edge, and sibling edges are
+// kept sorted for binary search. Matching compares raw path bytes and never decodes or
+// allocates. Captures are views into the matched path (decode one with
+// URI::percent_decode if needed). A built router is read-only, so any number of threads
+// may match against it without locking.
+//
+// Static segments win over parameters, which win over wildcards; a dead end backtracks
+// to the next alternative. A trailing slash is significant ("/a" and "/a/" differ).
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <map>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "uri.h"
+
+namespace cpptools {
+namespace net {
+
+struct RouteParam {
+    std::string_view name;
+    std::string_view value;  // raw, still percent-encoded
+};
+
+template <class T>
+struct RouteMatch {
+    static constexpr size_t kMaxParams = 8;
+
+    const T*                           value = nullptr;
+    std::string_view                   pattern;
+    size_t                             size = 0;
+    std::array<RouteParam, kMaxParams> params{};
+
+    explicit operator bool() const { return value != nullptr; }
+
+    std::optional<std::string_view> param(std::string_view name) const {
+        for (size_t i = 0; i < size; ++i)
+            if (params[i].name == name) return params[i].value;
+        return std::nullopt;
+    }
+};
+
+template <class T>
+class PathRouter final {
+   public:
+    class Builder;
+
+    PathRouter() : nodes_(1) {}
+
+    size_t size() const { return routes_.size(); }
+
+    // Best route for `path` (a raw path starting with '/'; empty means "/")
+    RouteMatch<T> match(std::string_view path) const {
+        RouteMatch<T> m;
+        if (path.empty()) path = "/";
+        if (path[0] != '/') return m;
+        std::array<std::string_view, RouteMatch<T>::kMaxParams> caps;
+        int route = walk(0, path, 1, caps, 0);
+        if (route < 0) return m;
+        const auto& r = routes_[route];
+        m.value       = &r.value;
+        m.pattern     = r.pattern;
+        m.size        = r.names.size();
+        for (size_t i = 0; i < m.size; ++i) m.params[i] = RouteParam{r.names[i], caps[i]};
+        return m;
+    }
+    // parsed URIs match on their raw path; constrained so strings never convert to a URI
+    template <class U>
+        requires std::same_as<U, URI> || std::same_as<U, URIView>
+    RouteMatch<T> match(const U& uri) const {
+        return match(uri.raw_path());
+    }
+
+   private:
+    static constexpr size_t npos = std::string_view::npos;
+
+    struct route {
+        T                        value;
+        std::string              pattern;
+        std::vector<std::string> names;  // capture names in path order
+    };
+    struct node {
+        uint32_t edge_begin = 0, edge_end = 0;
+        int32_t  param      = -1;  // child node for a "{name}" segment
+        int32_t  value      = -1;  // route ending here
+        int32_t  wildcard   = -1;  // route whose "{*name}" starts here
+    };
+    // static edge; the label holds one or more segments joined by '/'
+    struct edge {
+        uint32_t label_pos, label_len, first_len;
+        uint32_t child;
+    };
+
+    std::string_view label(const edge& e) const { return std::string_view(labels_).substr(e.label_pos, e.label_len); }
+
+    // match the segments of `path` from `pos` (npos: path exhausted) below node `n`
+    int walk(uint32_t n, std::string_view path, size_t pos,
+             std::array<std::string_view, RouteMatch<T>::kMaxParams>& caps, size_t ncap) const {
+        const node& nd = nodes_[n];
+        if (pos == npos) return nd.value;
+
+        size_t           end = std::min(path.find('/', pos), path.size());
+        std::string_view seg = path.substr(pos, end - pos);
+
+        auto first = edges_.begin() + nd.edge_begin, last = edges_.begin() + nd.edge_end;
+        auto it    = std::lower_bound(first, last, seg, [this](const edge& e, std::string_view s) {
+            return label(e).substr(0, e.first_len) < s;
+        });
+        if (it != last && label(*it).substr(0, it->first_len) == seg) {
+            std::string_view lbl = label(*it);
+            size_t           to  = pos + lbl.size();
+            if (path.substr(pos, lbl.size()) == lbl && (to == path.size() || path[to] == '/')) {
+                int r = walk(it->child, path, to == path.size() ? npos : to + 1, caps, ncap);
+                if (r >= 0) return r;
+            }
+        }
+        if (nd.param >= 0 && !seg.empty()) {
+            caps[ncap] = seg;
+            int r      = walk(uint32_t(nd.param), path, end == path.size() ? npos : end + 1, caps, ncap + 1);
+            if (r >= 0) return r;
+        }
+        if (nd.wildcard >= 0) {
+            caps[ncap] = path.substr(pos);
+            return nd.wildcard;
+        }
+        return -1;
+    }
+
+    std::vector<node>  nodes_;  // nodes_[0] is the root, positioned after the leading '/'
+    std::vector<edge>  edges_;
+    std::string        labels_;
+    std::vector<route> routes_;
+};
+
+// Collects routes, then compiles them. add() throws std::invalid_argument for malformed
+// or conflicting templates.
+template <class T>
+class PathRouter<T>::Builder {
+   public:
+    Builder& add(std::string_view pattern, T value) {
+        if (pattern.empty() || pattern[0] != '/') fail(pattern, "must start with '/'");
+        route r{std::move(value), std::string(pattern), {}};
+
+        tnode* n = &root_;
+        for (size_t pos = 1; pos != npos;) {
+            size_t           end = std::min(pattern.find('/', pos), pattern.size());
+            std::string_view seg = pattern.substr(pos, end - pos);
+            pos                  = end == pattern.size() ? npos : end + 1;
+
+            if (seg.find_first_of("{}") == npos) {
+                auto& child = n->statics[std::string(seg)];
+                if (!child) child = std::make_unique<tnode>();
+                n = child.get();
+                continue;
+            }
+            if (seg.size() < 3 || seg.front() != '{' || seg.back() != '}')
+                fail(pattern, "parameters must span a whole segment");
+            bool             wild = seg[1] == '*';
+            std::string_view name = seg.substr(wild ? 2 : 1, seg.size() - (wild ? 3 : 2));
+            if (name.empty() || name.find_first_of("{}*") != npos) fail(pattern, "bad parameter name");
+            if (std::find(r.names.begin(), r.names.end(), name) != r.names.end())
+                fail(pattern, "duplicate parameter name");
+            if (r.names.size() == RouteMatch<T>::kMaxParams) fail(pattern, "too many parameters");
+            r.names.emplace_back(name);
+            if (wild) {
+                if (pos != npos) fail(pattern, "wildcard must be the last segment");
+                if (n->wildcard >= 0) fail(pattern, "conflicts with an existing wildcard");
+                n->wildcard = int32_t(routes_.size());
+                routes_.push_back(std::move(r));
+                return *this;
+            }
+            if (!n->param) n->param = std::make_unique<tnode>();
+            n = n->param.get();
+        }
+        if (n->value >= 0) fail(pattern, "duplicate route");
+        n->value = int32_t(routes_.size());
+        routes_.push_back(std::move(r));
+        return *this;
+    }
+
+    PathRouter build() && {
+        PathRouter rt;
+        rt.nodes_.clear();
+        rt.nodes_.emplace_back();
+        compile(root_, 0, rt);
+        rt.routes_ = std::move(routes_);
+        return rt;
+    }
+    PathRouter build() const& { return Builder(*this).build(); }
+
+    Builder() = default;
+    Builder(const Builder& o) : routes_(o.routes_) { copy(o.root_, root_); }
+
+   private:
+    struct tnode {
+        std::map<std::string, std::unique_ptr<tnode>, std::less<>> statics;  // sorted, like the compiled edges
+        std::unique_ptr<tnode>                                     param;
+        int32_t                                                    value    = -1;
+        int32_t                                                    wildcard = -1;
+    };
+
+    [[noreturn]] static void fail(std::string_view pattern, const char* why) {
+        throw std::invalid_argument("route '" + std::string(pattern) + "': " + why);
+    }
+
+    static void copy(const tnode& from, tnode& to) {
+        to.value    = from.value;
+        to.wildcard = from.wildcard;
+        for (const auto& [seg, child] : from.statics) copy(*child, *(to.statics[seg] = std::make_unique<tnode>()));
+        if (from.param) copy(*from.param, *(to.param = std::make_unique<tnode>()));
+    }
+
+    // a node that only passes through to a single static child is folded into the edge
+    static bool foldable(const tnode& t) { return t.value < 0 && t.wildcard < 0 && !t.param && t.statics.size() == 1; }
+
+    static void compile(const tnode& t, uint32_t at, PathRouter& rt) {
+        rt.nodes_[at].value    = t.value;
+        rt.nodes_[at].wildcard = t.wildcard;
+
+        // reserve a contiguous edge range first so siblings stay sorted and adjacent
+        uint32_t begin = uint32_t(rt.edges_.size());
+        rt.edges_.resize(begin + t.statics.size());
+        rt.nodes_[at].edge_begin = begin;
+        rt.nodes_[at].edge_end   = uint32_t(rt.edges_.size());
+
+        uint32_t k = begin;
+        for (const auto& [seg, child] : t.statics) {
+            edge e{uint32_t(rt.labels_.size()), 0, uint32_t(seg.size()), 0};
+            rt.labels_ += seg;
+            const tnode* c = child.get();
+            while (foldable(*c)) {
+                rt.labels_ += '/';
+                rt.labels_ += c->statics.begin()->first;
+                c = c->statics.begin()->second.get();
+            }
+            e.label_len = uint32_t(rt.labels_.size() - e.label_pos);
+            e.child     = uint32_t(rt.nodes_.size());
+            rt.nodes_.emplace_back();
+            rt.edges_[k++] = e;
+            compile(*c, e.child, rt);
+        }
+        if (t.param) {
+            uint32_t p          = uint32_t(rt.nodes_.size());
+            rt.nodes_[at].param = int32_t(p);
+            rt.nodes_.emplace_back();
+            compile(*t.param, p, rt);
+        }
+    }
+
+    tnode              root_;
+    std::vector<route> routes_;
+};
+
+};  // namespace net
+};  // namespace cpptools
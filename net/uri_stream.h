@@ -0,0 +1,88 @@
+// Incremental URI parsing for input that arrives in pieces.
+//
+// Request targets often straddle several recv() buffers. URIStreamParser takes the chunks
+// as they come, appending them to one growing buffer. In strict mode the chunks are also
+// run through the strict DFA right away. So a malformed or oversized target is rejected
+// as soon as the offending byte arrives, not after the whole line has been read. finish()
+// lays out the components without rescanning and returns a view of the buffer. take()
+// moves the buffer into an owning URI.
+
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+
+#include "uri.h"
+
+namespace cpptools {
+namespace net {
+
+struct StreamOptions {
+    parse_mode mode       = parse_mode::lenient;  // lenient input is only checked once finished
+    size_t     max_length = 8192;                 // longer input fails with input_too_long
+};
+
+class URIStreamParser final {
+   public:
+    explicit URIStreamParser(const StreamOptions& opts = {}) : opts_(opts) {
+        opts_.max_length = std::min<size_t>(opts_.max_length, UINT32_MAX);
+    }
+
+    // Append the next chunk. A non-ok result is final: later calls return the same error
+    // until reset().
+    uri_error feed(std::string_view chunk) {
+        if (err_) return err_;
+        if (chunk.size() > opts_.max_length - buf_.size())
+            return err_ = detail::fail(uri_errc::input_too_long, opts_.max_length);
+        size_t from = buf_.size();
+        buf_.append(chunk);
+        if (opts_.mode == parse_mode::strict) err_ = scan_.feed(buf_, from);
+        return err_;
+    }
+
+    // End of input. The view points into the parser and stays valid until the next
+    // feed(), take() or reset().
+    parse_result<URIView> finish() {
+        detail::uri_layout l;
+        if (auto err = layout(l)) return err;
+        return URIView(buf_, l);
+    }
+
+    // End of input, handing the buffered bytes to an owning URI without copying them.
+    // Resets the parser on success.
+    parse_result<URI> take() {
+        detail::uri_layout l;
+        if (auto err = layout(l)) return err;
+        URI u(std::move(buf_), l);
+        reset();
+        return u;
+    }
+
+    // Start over with a new input, keeping the buffer's capacity unless take() handed it off
+    void reset() {
+        buf_.clear();
+        scan_ = {};
+        err_  = {};
+    }
+
+    std::string_view buffered() const { return buf_; }
+    size_t           size() const { return buf_.size(); }
+    uri_error        error() const { return err_; }
+
+   private:
+    uri_error layout(detail::uri_layout& l) {
+        if (err_) return err_;
+        if (buf_.empty()) return detail::fail(uri_errc::empty_input, 0);
+        if (opts_.mode == parse_mode::strict) return err_ = scan_.finish(buf_, l);
+        return err_ = detail::parse_layout(buf_, l, parse_mode::lenient);
+    }
+
+    StreamOptions          opts_;
+    std::string            buf_;
+    detail::strict_scanner scan_;
+    uri_error              err_;
+};
+
+};  // namespace net
+};  // namespace cpptools
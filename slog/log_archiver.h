@@ -0,0 +1,353 @@
+#pragma once
+
+// Background compression of rotated log files.
+//
+// A file sink that rotates with a LogArchiver does a single rename of the finished file
+// to a `.pending` name and queues it; everything else happens on the archiver's thread,
+// which runs at idle CPU and I/O priority: compress to `app.1.log.gz` (or `.zst`), shift
+// the older archives up and drop the ones past `max_files`. Logging never waits for it.
+// If the thread falls more than `max_files` files behind, the oldest pending files are
+// deleted on that thread without being compressed, since retention would drop them
+// anyway.
+//
+// A pending file that fails to compress is left as it is and counts against `max_files`
+// together with the queue, the failed ones going first. Pending files found on start,
+// left by a failure or a crash, are queued ahead of new ones. An archiver only compresses
+// a file it holds an flock on, so two archivers on the same base name, as during a
+// re-Init, do not process the same file twice.
+//
+// Codecs are compiled in on request so that slog users who do not compress need not
+// link them: define SLOG_WITH_ZLIB (link -lz) for GZIP and SLOG_WITH_ZSTD (link -lzstd)
+// for ZSTD. Asking for a codec that was not compiled in throws at construction.
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <spdlog/details/file_helper.h>
+#include <spdlog/details/os.h>
+#include <spdlog/sinks/base_sink.h>
+#include <spdlog/sinks/rotating_file_sink.h>
+
+#ifdef SLOG_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef SLOG_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+namespace cpptools {
+namespace slog {
+
+enum class LogCompression {
+    NONE,
+    GZIP,  // needs SLOG_WITH_ZLIB
+    ZSTD,  // needs SLOG_WITH_ZSTD
+};
+
+class LogArchiver {
+   public:
+    LogArchiver(std::string base_filename, size_t max_files, LogCompression compression)
+        : base_(std::move(base_filename)), max_files_(max_files), compression_(compression) {
+        switch (compression_) {
+            case LogCompression::NONE: break;
+            case LogCompression::GZIP:
+#ifndef SLOG_WITH_ZLIB
+                spdlog::throw_spdlog_ex("log archiver: built without SLOG_WITH_ZLIB");
+#endif
+                break;
+            case LogCompression::ZSTD:
+#ifndef SLOG_WITH_ZSTD
+                spdlog::throw_spdlog_ex("log archiver: built without SLOG_WITH_ZSTD");
+#endif
+                break;
+        }
+        seq_ = uint64_t(std::chrono::system_clock::now().time_since_epoch().count());
+        requeue_pending();
+        worker_ = std::thread([this] { work(); });
+    }
+
+    // finishes the queue before returning
+    ~LogArchiver() {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        worker_.join();
+    }
+
+    LogArchiver(const LogArchiver&) = delete;
+    LogArchiver& operator=(const LogArchiver&) = delete;
+
+    // app.1.log.gz for index 1
+    std::string archive_name(size_t index) const {
+        return spdlog::sinks::rotating_file_sink_mt::calc_filename(base_, index) + suffix();
+    }
+
+    // Moves the closed `path` out of the way and queues it; one rename on the caller's thread
+    void submit(const std::string& path) {
+        std::unique_lock<std::mutex> lk(mu_);
+        std::string pending = base_ + "." + std::to_string(++seq_) + ".pending";
+        if (::rename(path.c_str(), pending.c_str()) != 0) return;
+        queue_.push_back(std::move(pending));
+        trim();
+        lk.unlock();
+        cv_.notify_all();
+    }
+
+    // blocks until everything submitted so far is archived; for tests and shutdown paths
+    void wait_idle() {
+        std::unique_lock<std::mutex> lk(mu_);
+        cv_.wait(lk, [this] { return queue_.empty() && doomed_.empty() && !busy_; });
+    }
+
+   private:
+    // under mu_: hand the worker what to delete so that at most max_files pending files
+    // remain, oldest first
+    void trim() {
+        while (queue_.size() + failed_.size() > max_files_) {
+            auto& from = failed_.empty() ? queue_ : failed_;
+            doomed_.push_back(std::move(from.front()));
+            from.pop_front();
+        }
+    }
+
+    // app.log.<seq>.pending files left by an earlier run, by sequence number
+    void requeue_pending() {
+        std::string dir = spdlog::details::os::dir_name(base_);
+        std::string prefix = base_.substr(dir.empty() ? 0 : dir.size() + 1) + ".";
+        std::vector<std::pair<uint64_t, std::string>> found;
+        if (DIR* d = ::opendir(dir.empty() ? "." : dir.c_str())) {
+            while (dirent* e = ::readdir(d)) {
+                std::string name = e->d_name;
+                const std::string tail = ".pending";
+                if (name.size() <= prefix.size() + tail.size() || name.compare(0, prefix.size(), prefix) != 0 ||
+                    name.compare(name.size() - tail.size(), tail.size(), tail) != 0)
+                    continue;
+                std::string seq = name.substr(prefix.size(), name.size() - prefix.size() - tail.size());
+                if (seq.find_first_not_of("0123456789") != std::string::npos) continue;
+                found.emplace_back(std::strtoull(seq.c_str(), nullptr, 10), dir.empty() ? name : dir + "/" + name);
+            }
+            ::closedir(d);
+        }
+        std::sort(found.begin(), found.end());
+        for (auto& f : found) queue_.push_back(std::move(f.second));
+        trim();
+    }
+
+    const char* suffix() const {
+        switch (compression_) {
+            case LogCompression::GZIP: return ".gz";
+            case LogCompression::ZSTD: return ".zst";
+            default: return "";
+        }
+    }
+
+    static void lower_priority() {
+        // from <linux/ioprio.h>, which older kernel headers do not ship
+        constexpr int kIoprioWhoProcess = 1;
+        constexpr int kIoprioClassIdle = 3;
+        constexpr int kIoprioClassShift = 13;
+        // nice and ioprio apply to the calling thread when given its tid
+        pid_t tid = pid_t(::syscall(SYS_gettid));
+        (void)::setpriority(PRIO_PROCESS, id_t(tid), 19);
+        (void)::syscall(SYS_ioprio_set, kIoprioWhoProcess, tid, kIoprioClassIdle << kIoprioClassShift);
+    }
+
+    void work() {
+        lower_priority();
+        std::unique_lock<std::mutex> lk(mu_);
+        for (;;) {
+            cv_.wait(lk, [this] { return stop_ || !queue_.empty() || !doomed_.empty(); });
+            if (!doomed_.empty()) {
+                std::deque<std::string> doomed = std::move(doomed_);
+                doomed_.clear();
+                busy_ = true;
+                lk.unlock();
+                for (auto& f : doomed) ::unlink(f.c_str());
+                lk.lock();
+                busy_ = false;
+                cv_.notify_all();
+                continue;
+            }
+            if (queue_.empty()) return;
+            std::string pending = std::move(queue_.front());
+            queue_.pop_front();
+            busy_ = true;
+            lk.unlock();
+            bool done = archive(pending);
+            lk.lock();
+            busy_ = false;
+            if (!done) {
+                failed_.push_back(std::move(pending));
+                trim();
+            }
+            cv_.notify_all();
+        }
+    }
+
+    // Compress, then shift app.1.log.gz -> app.2.log.gz ... and put the new one first.
+    // False if the pending file is left behind uncompressed.
+    bool archive(const std::string& pending) {
+        int in = ::open(pending.c_str(), O_RDONLY | O_CLOEXEC);
+        if (in < 0) return true;  // dropped, or finished by another archiver
+        if (!claim(in, pending)) {
+            ::close(in);
+            return true;
+        }
+        std::string tmp = pending + suffix();
+        bool ok = compress(in, tmp);
+        ::close(in);
+        if (!ok) {
+            // keep the plain file rather than lose it
+            ::unlink(tmp.c_str());
+            return false;
+        }
+        ::unlink(pending.c_str());
+        for (size_t i = max_files_; i > 1; --i) {
+            std::string src = archive_name(i - 1);
+            if (spdlog::details::os::path_exists(src)) ::rename(src.c_str(), archive_name(i).c_str());
+        }
+        ::rename(tmp.c_str(), archive_name(1).c_str());
+        return true;
+    }
+
+    // whether we hold the file's lock and it is still there, not finished by another archiver
+    static bool claim(int fd, const std::string& path) {
+        if (::flock(fd, LOCK_EX | LOCK_NB) != 0) return false;
+        struct stat a, b;
+        return ::fstat(fd, &a) == 0 && ::stat(path.c_str(), &b) == 0 && a.st_dev == b.st_dev && a.st_ino == b.st_ino;
+    }
+
+    bool compress(int in, const std::string& dst) const {
+        switch (compression_) {
+            case LogCompression::GZIP: return gzip(in, dst);
+            case LogCompression::ZSTD: return zstd(in, dst);
+            default: return false;
+        }
+    }
+
+    static constexpr size_t kChunk = 128 * 1024;
+
+    static bool gzip([[maybe_unused]] int in, [[maybe_unused]] const std::string& dst) {
+#ifdef SLOG_WITH_ZLIB
+        gzFile out = ::gzopen(dst.c_str(), "wb6e");
+        if (!out) return false;
+        std::vector<char> buf(kChunk);
+        bool ok = true;
+        for (;;) {
+            ssize_t n = ::read(in, buf.data(), buf.size());
+            if (n <= 0) {
+                ok = n == 0;
+                break;
+            }
+            if (::gzwrite(out, buf.data(), unsigned(n)) != int(n)) {
+                ok = false;
+                break;
+            }
+        }
+        return ::gzclose(out) == Z_OK && ok;
+#else
+        return false;
+#endif
+    }
+
+    static bool zstd([[maybe_unused]] int in, [[maybe_unused]] const std::string& dst) {
+#ifdef SLOG_WITH_ZSTD
+        std::FILE* out = std::fopen(dst.c_str(), "wbe");
+        if (!out) return false;
+        std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)> cctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+        bool ok = cctx && !ZSTD_isError(ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_compressionLevel, 3));
+        std::vector<char> ibuf(ZSTD_CStreamInSize()), obuf(ZSTD_CStreamOutSize());
+        for (bool last = false; ok && !last;) {
+            ssize_t n = ::read(in, ibuf.data(), ibuf.size());
+            if (n < 0) {
+                ok = false;
+                break;
+            }
+            last = n == 0;
+            ZSTD_inBuffer input{ibuf.data(), size_t(n), 0};
+            for (bool done = false; ok && !done;) {
+                ZSTD_outBuffer output{obuf.data(), obuf.size(), 0};
+                size_t left = ZSTD_compressStream2(cctx.get(), &output, &input, last ? ZSTD_e_end : ZSTD_e_continue);
+                ok = !ZSTD_isError(left) && std::fwrite(obuf.data(), 1, output.pos, out) == output.pos;
+                done = last ? left == 0 : input.pos == input.size;
+            }
+        }
+        return std::fclose(out) == 0 && ok;
+#else
+        return false;
+#endif
+    }
+
+    std::string base_;
+    size_t max_files_;
+    LogCompression compression_;
+
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::deque<std::string> queue_;   // pending files, oldest first
+    std::deque<std::string> failed_;  // pending files that did not compress, oldest first
+    std::deque<std::string> doomed_;  // trimmed pending files, for the worker to delete
+    uint64_t seq_ = 0;
+    bool busy_ = false;
+    bool stop_ = false;
+    std::thread worker_;
+};
+
+// Size-rotating file sink, like spdlog's rotating_file_sink, that hands rotated files to a
+// LogArchiver instead of renaming the whole chain under the sink lock.
+class ArchivingFileSink final : public spdlog::sinks::base_sink<std::mutex> {
+   public:
+    ArchivingFileSink(std::string base_filename, size_t max_size, size_t max_files, LogCompression compression)
+        : base_(std::move(base_filename)), max_size_(max_size), archiver_(base_, max_files, compression) {
+        file_.open(base_, false);
+        size_ = file_.size();
+    }
+
+    LogArchiver& archiver() { return archiver_; }
+
+   protected:
+    void sink_it_(const spdlog::details::log_msg& msg) override {
+        spdlog::memory_buf_t formatted;
+        formatter_->format(msg, formatted);
+        if (size_ > 0 && size_ + formatted.size() > max_size_) {
+            file_.close();
+            archiver_.submit(base_);
+            file_.open(base_, true);
+            size_ = 0;
+        }
+        file_.write(formatted);
+        size_ += formatted.size();
+    }
+
+    void flush_() override { file_.flush(); }
+
+   private:
+    std::string base_;
+    size_t max_size_;
+    size_t size_ = 0;
+    spdlog::details::file_helper file_;
+    LogArchiver archiver_;  // destroyed first, so its queue is finished before we return
+};
+
+};  // namespace slog
+};  // namespace cpptools
@@ -0,0 +1,367 @@
+#pragma once
+
+// Memory-mapped rotating file sink.
+//
+// Each log file is a fixed-size segment, preallocated with posix_fallocate and mapped
+// MAP_SHARED; a log line is a memcpy into the mapping, and flush() is msync(MS_ASYNC).
+// A background thread keeps the next segment open and mapped, so a full segment is
+// retired by swapping pointers; closing, truncating and renaming the old file happen on
+// that thread, outside the sink lock. Lines already copied survive a crash of the process
+// (they are in the page cache), not of the machine. A line that does not fit in what is
+// left of a segment starts the next one; only lines longer than a segment span files.
+//
+// Naming follows spdlog's rotating_file_sink: the live file is `app.log`, older ones
+// `app.1.log` ... `app.<max_files>.log`. An existing `app.log` is rotated out on open
+// rather than appended to. While a segment is live its file is `max_size` bytes with a
+// zero-filled tail; it is truncated to what was written when it is retired or closed.
+// With a LogCompression other than NONE, retired files go to a LogArchiver instead.
+//
+// The next segment is an unnamed O_TMPFILE (or, where the filesystem lacks it, a file
+// with a unique name) and is linked as `app.log` only when it goes live, with link(2),
+// which never replaces an existing file. A sink only rotates the chain while `app.log`
+// is still its own file, and its destructor touches nothing by path, so a second sink
+// on the same file (a re-Init) takes over the name without the first one truncating or
+// clobbering it. A sink that has lost the name files its later segments as `app.1.log`,
+// shifting the older ones up, or when compressing hands them to the archiver.
+//
+// If the next segment cannot be prepared, the sink keeps appending to the full one with
+// write(2), reports the error once through the logger's error handler and retries every
+// second.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <spdlog/details/os.h>
+#include <spdlog/sinks/base_sink.h>
+#include <spdlog/sinks/rotating_file_sink.h>
+
+#include "log_archiver.h"
+
+namespace cpptools {
+namespace slog {
+
+class MmapFileSink final : public spdlog::sinks::base_sink<std::mutex> {
+   public:
+    MmapFileSink(std::string base_filename, size_t max_size, size_t max_files,
+                 LogCompression compression = LogCompression::NONE)
+        : base_(std::move(base_filename)), max_files_(max_files) {
+        size_t page = size_t(::sysconf(_SC_PAGESIZE));
+        size_ = std::max(page, (max_size + page - 1) / page * page);
+
+        spdlog::details::os::create_dir(spdlog::details::os::dir_name(base_));
+        if (compression != LogCompression::NONE)
+            archiver_ = std::make_unique<LogArchiver>(base_, max_files, compression);
+        current_ = open_segment();
+        // another sink may name a new app.log between our rotation and the link; rotate it too
+        bool named = false;
+        for (int tries = 0; tries < 3 && !named; ++tries) {
+            if (spdlog::details::os::path_exists(base_)) rotate_files();
+            named = link_segment(current_, base_);
+        }
+        if (!named) {
+            int err = errno;
+            discard_segment(current_);
+            spdlog::throw_spdlog_ex("mmap sink: cannot create " + base_, err);
+        }
+        live_ = current_;
+        name_ = base_;
+        worker_ = std::thread([this] { work(); });
+    }
+
+    ~MmapFileSink() override {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        worker_.join();
+        close_segment(current_);
+        discard_segment(next_);
+        if (archiver_ && !name_.empty() && name_ != base_) archiver_->submit(name_);
+    }
+
+    MmapFileSink(const MmapFileSink&) = delete;
+    MmapFileSink& operator=(const MmapFileSink&) = delete;
+
+    size_t segment_size() const { return size_; }
+    LogArchiver* archiver() const { return archiver_.get(); }
+
+   protected:
+    void sink_it_(const spdlog::details::log_msg& msg) override {
+        spdlog::memory_buf_t formatted;
+        formatter_->format(msg, formatted);
+        const char* p = formatted.data();
+        size_t n = formatted.size();
+        // keep lines whole: start a new segment unless the line could not fit in one anyway
+        if (current_.used && current_.used + n > size_ && (n <= size_ || current_.used >= size_)) switch_segment();
+        while (n) {
+            if (current_.used >= size_ && !switch_segment()) {
+                append(p, n);
+                break;
+            }
+            size_t k = std::min(n, size_ - current_.used);
+            std::memcpy(current_.data + current_.used, p, k);
+            current_.used += k;
+            p += k;
+            n -= k;
+        }
+        if (error_pending_.load(std::memory_order_relaxed)) raise_error();
+    }
+
+    void flush_() override {
+        if (current_.used) ::msync(current_.data, std::min(current_.used, size_), MS_ASYNC);
+    }
+
+   private:
+    struct segment {
+        int fd = -1;
+        char* data = nullptr;
+        size_t used = 0;  // may pass the mapped size when the next segment was not ready
+        dev_t dev = 0;
+        ino_t ino = 0;
+        std::string tmp;  // unique name on filesystems without O_TMPFILE, until linked
+    };
+
+    segment open_segment() const {
+        segment s;
+        std::string dir = spdlog::details::os::dir_name(base_);
+        s.fd = ::open(dir.empty() ? "." : dir.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0644);
+        if (s.fd < 0 && (errno == EOPNOTSUPP || errno == EISDIR)) {
+            std::string tmp = base_ + ".XXXXXX";
+            s.fd = ::mkostemp(tmp.data(), O_CLOEXEC);
+            if (s.fd >= 0) s.tmp = std::move(tmp);
+        }
+        if (s.fd < 0) spdlog::throw_spdlog_ex("mmap sink: cannot open a segment for " + base_, errno);
+        struct stat st;
+        if (::fstat(s.fd, &st) != 0) {
+            int err = errno;
+            discard_segment(s);
+            spdlog::throw_spdlog_ex("mmap sink: cannot stat a segment for " + base_, err);
+        }
+        s.dev = st.st_dev;
+        s.ino = st.st_ino;
+        if (int err = ::posix_fallocate(s.fd, 0, off_t(size_))) {
+            discard_segment(s);
+            spdlog::throw_spdlog_ex("mmap sink: cannot allocate a segment for " + base_, err);
+        }
+        void* p = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, s.fd, 0);
+        if (p == MAP_FAILED) {
+            int err = errno;
+            discard_segment(s);
+            spdlog::throw_spdlog_ex("mmap sink: cannot map a segment for " + base_, err);
+        }
+        s.data = static_cast<char*>(p);
+        return s;
+    }
+
+    // gives the segment its name; fails with EEXIST rather than replace a file
+    static bool link_segment(segment& s, const std::string& path) {
+        if (!s.tmp.empty()) {
+            if (::link(s.tmp.c_str(), path.c_str()) != 0) return false;
+            ::unlink(s.tmp.c_str());
+            s.tmp.clear();
+            return true;
+        }
+        char proc[32];
+        std::snprintf(proc, sizeof proc, "/proc/self/fd/%d", s.fd);
+        return ::linkat(AT_FDCWD, proc, AT_FDCWD, path.c_str(), AT_SYMLINK_FOLLOW) == 0;
+    }
+
+    // unmap and cut the file down to what was written
+    void close_segment(segment& s) const {
+        if (!s.data) return;
+        ::msync(s.data, std::min(s.used, size_), MS_ASYNC);
+        ::munmap(s.data, size_);
+        if (::ftruncate(s.fd, off_t(s.used)) != 0) {
+            // keep the zero tail rather than fail; readers see the same bytes either way
+        }
+        ::close(s.fd);
+        s = segment{};
+    }
+
+    // drop a segment that never went live
+    void discard_segment(segment& s) const {
+        if (s.data) ::munmap(s.data, size_);
+        if (s.fd >= 0) ::close(s.fd);
+        if (!s.tmp.empty()) ::unlink(s.tmp.c_str());
+        s = segment{};
+    }
+
+    // whether app.log is still the given segment's file, or gone
+    bool owns_name(const segment& s) const {
+        struct stat st;
+        if (::stat(base_.c_str(), &st) != 0) return errno == ENOENT;
+        return st.st_dev == s.dev && st.st_ino == s.ino;
+    }
+
+    // app.log -> app.1.log -> ... -> app.<max_files>.log, dropping the oldest; or, when
+    // compressing, hand app.log to the archiver
+    void rotate_files() const {
+        using spdlog::sinks::rotating_file_sink_mt;
+        if (archiver_) {
+            archiver_->submit(base_);
+            return;
+        }
+        if (max_files_ == 0) {
+            ::unlink(base_.c_str());
+            return;
+        }
+        for (size_t i = max_files_; i > 0; --i) {
+            std::string src = rotating_file_sink_mt::calc_filename(base_, i - 1);
+            if (!spdlog::details::os::path_exists(src)) continue;
+            std::string dst = rotating_file_sink_mt::calc_filename(base_, i);
+            ::rename(src.c_str(), dst.c_str());
+        }
+    }
+
+    // Another sink has taken app.log: app.1.log for the live segment, after shifting the
+    // older ones up, or a unique name for the archiver to pick up once the segment is done.
+    // Empty when no rotated files are kept.
+    std::string name_below(const segment& live) const {
+        using spdlog::sinks::rotating_file_sink_mt;
+        if (archiver_) return base_ + "." + std::to_string(::getpid()) + "." + std::to_string(live.ino);
+        if (max_files_ == 0) return {};
+        for (size_t i = max_files_; i > 1; --i) {
+            std::string src = rotating_file_sink_mt::calc_filename(base_, i - 1);
+            if (spdlog::details::os::path_exists(src))
+                ::rename(src.c_str(), rotating_file_sink_mt::calc_filename(base_, i).c_str());
+        }
+        return rotating_file_sink_mt::calc_filename(base_, 1);
+    }
+
+    // Writer side, under the sink lock: take the prepared segment, hand the full one to
+    // the worker. Waits only if the worker has not finished the previous rotation; returns
+    // false at once while the worker cannot prepare segments.
+    bool switch_segment() {
+        std::unique_lock<std::mutex> lk(mu_);
+        cv_.wait(lk, [this] { return next_.data != nullptr || failed_; });
+        if (!next_.data) return false;
+        retired_ = std::exchange(current_, std::exchange(next_, segment{}));
+        live_ = current_;
+        lk.unlock();
+        cv_.notify_all();
+        return true;
+    }
+
+    // past the end of the mapping, while there is no segment to switch to
+    void append(const char* p, size_t n) {
+        while (n) {
+            ssize_t k = ::pwrite(current_.fd, p, n, off_t(current_.used));
+            if (k < 0 && errno == EINTR) continue;
+            if (k <= 0) {
+                set_error("mmap sink: cannot write " + base_, errno);
+                return;
+            }
+            current_.used += size_t(k);
+            p += k;
+            n -= size_t(k);
+        }
+    }
+
+    // the first error of a run is reported; it is thrown from sink_it_ so that the logger
+    // hands it to its error handler
+    void set_error(const std::string& what, int err) {
+        std::lock_guard<std::mutex> lk(mu_);
+        if (error_.empty()) {
+            error_ = spdlog::spdlog_ex(what, err).what();
+            error_pending_.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    void raise_error() {
+        std::string what;
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            what = error_;
+            error_pending_.store(false, std::memory_order_relaxed);
+        }
+        if (!what.empty()) spdlog::throw_spdlog_ex(what);
+    }
+
+    void work() {
+        std::unique_lock<std::mutex> lk(mu_);
+        for (;;) {
+            auto ready = [this] { return stop_ || retired_.data || (!next_.data && !failed_); };
+            if (failed_)
+                cv_.wait_for(lk, std::chrono::seconds(1), ready);
+            else
+                cv_.wait(lk, ready);
+            if (retired_.data) {
+                segment old = std::exchange(retired_, segment{});
+                segment live = live_;
+                lk.unlock();
+                // the new live segment is unnamed until the old one gives up app.log
+                bool owner = owns_name(old);
+                close_segment(old);
+                std::string name = base_;
+                if (owner) {
+                    if (spdlog::details::os::path_exists(base_)) rotate_files();
+                } else {
+                    if (archiver_ && name_ != base_) archiver_->submit(name_);
+                    name = name_below(live);
+                }
+                if (!name.empty() && !link_segment(live, name)) set_error("mmap sink: cannot name " + name, errno);
+                name_ = std::move(name);
+                lk.lock();
+                continue;
+            }
+            if (stop_) return;
+            if (next_.data) continue;
+            lk.unlock();
+            segment s;
+            std::string error;
+            try {
+                s = open_segment();
+            } catch (const spdlog::spdlog_ex& e) {
+                error = e.what();
+            }
+            lk.lock();
+            if (!error.empty() && !failed_ && error_.empty()) {
+                error_ = std::move(error);
+                error_pending_.store(true, std::memory_order_relaxed);
+            }
+            failed_ = !s.data;
+            if (s.data) error_.clear();
+            next_ = std::move(s);
+            cv_.notify_all();
+        }
+    }
+
+    std::string base_;
+    size_t max_files_;
+    size_t size_;
+    std::unique_ptr<LogArchiver> archiver_;  // outlives the worker, which feeds it
+
+    segment current_;  // under the sink lock
+
+    std::mutex mu_;  // worker handoff
+    std::condition_variable cv_;
+    segment next_;     // mapped and ready, not yet named
+    segment retired_;  // full, waiting for the worker
+    segment live_;     // copy of current_ for the worker to name
+    std::string name_;  // what the live segment was named; the worker's, then the destructor's
+    bool failed_ = false;
+    bool stop_ = false;
+    std::string error_;  // not yet reported, or reported and not yet recovered from
+    std::atomic<bool> error_pending_{false};
+    std::thread worker_;
+};
+
+};  // namespace slog
+};  // namespace cpptools
@@ -1,15 +1,52 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
-#include <sstream>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <iterator>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 #include <spdlog/spdlog.h>
+#include <spdlog/async.h>
+#include <spdlog/sinks/base_sink.h>
+#include <spdlog/sinks/dist_sink.h>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/fmt/ostr.h>
+#if defined(SPDLOG_FMT_EXTERNAL)
+#include <fmt/args.h>
+#else
+#include <spdlog/fmt/bundled/args.h>
+#endif
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/sinks/rotating_file_sink.h>
 
+#include "mmap_file_sink.h"
+
+// Compile-time minimum level: LOG() statements below it compile to nothing.
+// e.g. -DSLOG_MIN_LEVEL=SLOG_LEVEL_INFO strips every LOG(DEBUG) from release builds.
+#define SLOG_LEVEL_DEBUG 1
+#define SLOG_LEVEL_INFO 2
+#define SLOG_LEVEL_WARNING 3
+#define SLOG_LEVEL_ERROR 4
+#define SLOG_LEVEL_FATAL 5
+#ifndef SLOG_MIN_LEVEL
+#define SLOG_MIN_LEVEL SLOG_LEVEL_DEBUG
+#endif
+
 namespace cpptools {
 namespace slog {
 
@@ -21,6 +58,43 @@ enum class LogSeverity {
     FATAL = spdlog::level::critical
 };
 
+static_assert(SLOG_LEVEL_DEBUG == spdlog::level::debug && SLOG_LEVEL_FATAL == spdlog::level::critical);
+
+// FATAL can never be compiled out, CHECK() depends on it
+constexpr LogSeverity kMinLogLevel = static_cast<LogSeverity>(SLOG_MIN_LEVEL < SLOG_LEVEL_FATAL ? SLOG_MIN_LEVEL
+                                                                                              : SLOG_LEVEL_FATAL);
+
+namespace detail {
+
+// "a/b/c.cpp" -> "c.cpp", at compile time for __FILE__
+constexpr const char* Basename(const char* path) {
+    const char* base = path;
+    for (const char* p = path; *p; ++p)
+        if (*p == '/') base = p + 1;
+    return base;
+}
+
+}  // namespace detail
+
+// One LOG()/LOGF() statement. The macros keep one per call site in static storage;
+// deferred records point at it instead of carrying file, line and format.
+struct LogSite {
+    const char* file;  // basename, for the "[file:line]" prefix
+    const char* path;  // __FILE__, for vmodule patterns with a '/'
+    int line;
+    LogSeverity severity;
+    std::string_view format = {};  // LOGF only
+    // vmodule decision: generation << 8 | effective level; see IsLogOn(const LogSite&)
+    mutable std::atomic<uint64_t> level_cache{0};
+};
+
+// What an async logger does when its queue is full
+enum class AsyncOverflow {
+    BLOCK,           // wait for room
+    DROP,            // discard the new message
+    OVERRUN_OLDEST,  // discard the oldest queued message
+};
+
 struct LogConfig {
     std::string progname = "app";
     LogSeverity log_level = LogSeverity::INFO;  // --loglevel
@@ -28,117 +102,1159 @@ struct LogConfig {
     std::string log_file = "./logs/app.log";    // --logfile
     size_t max_file_size = 50 * 1024 * 1024;    // rolling size
     size_t max_files = 10;                      // rolling count
+    bool log_file_mmap = false;                 // --logfilemmap, see MmapFileSink
+    // compress rotated files in the background; max_files then counts archives
+    LogCompression log_file_compression = LogCompression::NONE;  // --logcompress, see LogArchiver
+    std::string console_pattern = "[%Y-%m-%d %H:%M:%S.%e] [%^%l%$] %v";
+    std::string file_pattern = "[%Y-%m-%d %H:%M:%S.%e] [%l] %v";
+    // per-module levels, e.g. "uri_*=DEBUG,net/*=INFO,chatty=ERROR"; a pattern matches the
+    // file name with or without extension, or, if it has a '/', the end of the path
+    std::string vmodule;  // --vmodule
+
+    // async backend: sinks are written by background threads, LOG() only enqueues
+    bool async = false;                                   // --logasync
+    size_t async_queue_size = 8192;                       // queued messages
+    size_t async_threads = 1;                             // writer threads
+    AsyncOverflow async_overflow = AsyncOverflow::BLOCK;  // full-queue policy
+
+    // deferred backend: LOG()/LOGF() copy their raw arguments into a per-thread ring and a
+    // background thread formats them. A full ring blocks under BLOCK and drops otherwise.
+    bool deferred = false;                // --logdeferred
+    size_t deferred_ring_size = 1 << 20;  // bytes per thread
+};
+
+struct LogStats {
+    uint64_t dropped = 0;  // AsyncOverflow::DROP, or a full deferred ring
+    uint64_t overrun = 0;  // AsyncOverflow::OVERRUN_OLDEST
+};
+
+// Counts flushes that reach the sinks. An async flush() only enqueues a request; waiting
+// for this count to move tells us the writer threads got past everything before it.
+class FlushSignalSink final : public spdlog::sinks::base_sink<std::mutex> {
+   public:
+    bool wait_past(uint64_t seen, std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lk(mu_);
+        return cv_.wait_for(lk, timeout, [&] { return flushes_ > seen; });
+    }
+    uint64_t flushes() {
+        std::lock_guard<std::mutex> lk(mu_);
+        return flushes_;
+    }
+
+   protected:
+    void sink_it_(const spdlog::details::log_msg&) override {}
+    void flush_() override {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            ++flushes_;
+        }
+        cv_.notify_all();
+    }
+
+   private:
+    std::mutex mu_;
+    std::condition_variable cv_;
+    uint64_t flushes_ = 0;
+};
+
+using LineBuffer = fmt::basic_memory_buffer<char, 512>;
+
+namespace detail {
+
+// Call-site timestamp: the TSC where there is one, steady_clock nanoseconds elsewhere.
+// DeferredLog converts it to wall time when the record is formatted.
+inline uint64_t Cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+}
+
+// Fixed header of a deferred record; encoded arguments follow it
+struct RecordHeader {
+    uint32_t size;         // whole record, padded to 8 bytes; 0-site records are ring padding
+    uint32_t len;          // whole record, unpadded
+    const LogSite* site;
+    uint64_t cycles;
 };
 
+enum class ArgTag : uint8_t { I64, U64, F32, F64, BOOL, CHAR, STR, PTR };
+
+// Append `value` the way LogStream prints it: bools as 1/0, floats as %g, types fmt does
+// not know through their operator<<
+template <typename T>
+void AppendFormatted(LineBuffer& buf, const T& value) {
+    auto out = std::back_inserter(buf);
+    if constexpr (std::is_same_v<T, bool>) {
+        buf.push_back(value ? '1' : '0');
+    } else if constexpr (std::is_floating_point_v<T>) {
+        fmt::format_to(out, "{:g}", value);
+    } else if constexpr (fmt::is_formattable<T>::value) {
+        fmt::format_to(out, "{}", value);
+    } else {
+#if FMT_VERSION >= 90000
+        fmt::format_to(out, "{}", fmt::streamed(value));
+#else
+        fmt::format_to(out, "{}", value);
+#endif
+    }
+}
+
+// resize() + memcpy: buffer::append is not inlined and costs more than the copy
+inline void PutBytes(LineBuffer& buf, const void* p, size_t n) {
+    size_t at = buf.size();
+    buf.resize(at + n);
+    std::memcpy(buf.data() + at, p, n);
+}
+
+template <typename T>
+void Put(LineBuffer& buf, const T& v) {
+    PutBytes(buf, &v, sizeof(v));
+}
+
+inline void PutString(LineBuffer& buf, std::string_view s) {
+    Put(buf, ArgTag::STR);
+    Put(buf, uint32_t(s.size()));
+    PutBytes(buf, s.data(), s.size());
+}
+
+// Copy one argument into a deferred record. Scalars and strings are copied raw; anything
+// else is formatted here, on the calling thread, and travels as a string.
+template <typename T>
+void EncodeArg(LineBuffer& buf, const T& value) {
+    using U = std::decay_t<T>;
+    if constexpr (std::is_same_v<U, bool>) {
+        Put(buf, ArgTag::BOOL);
+        Put(buf, value);
+    } else if constexpr (std::is_same_v<U, char>) {
+        Put(buf, ArgTag::CHAR);
+        Put(buf, value);
+    } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+        Put(buf, ArgTag::I64);
+        Put(buf, int64_t(value));
+    } else if constexpr (std::is_integral_v<U>) {
+        Put(buf, ArgTag::U64);
+        Put(buf, uint64_t(value));
+    } else if constexpr (std::is_same_v<U, float>) {
+        Put(buf, ArgTag::F32);
+        Put(buf, value);
+    } else if constexpr (std::is_floating_point_v<U>) {
+        Put(buf, ArgTag::F64);
+        Put(buf, double(value));
+    } else if constexpr (std::is_same_v<T, const char*> || std::is_same_v<T, char*>) {
+        PutString(buf, value ? std::string_view(value) : std::string_view("(null)"));
+    } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+        PutString(buf, std::string_view(value));
+    } else if constexpr (std::is_pointer_v<U>) {
+        Put(buf, ArgTag::PTR);
+        Put(buf, static_cast<const void*>(value));
+    } else {
+        LineBuffer tmp;
+        AppendFormatted(tmp, value);
+        PutString(buf, std::string_view(tmp.data(), tmp.size()));
+    }
+}
+
+// Format a deferred record as "[file:line] message" into `out`
+inline void RenderRecord(const char* rec, LineBuffer& out) {
+    RecordHeader h;
+    std::memcpy(&h, rec, sizeof(h));
+    const LogSite& site = *h.site;
+    fmt::format_to(std::back_inserter(out), "[{}:{}] ", site.file, site.line);
+
+    const char* p = rec + sizeof(h);
+    const char* end = rec + h.len;
+    auto take = [&p](auto& v) {
+        std::memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+    };
+    auto next = [&](auto&& visit) {
+        ArgTag tag;
+        take(tag);
+        switch (tag) {
+            case ArgTag::I64: { int64_t v; take(v); visit(v); break; }
+            case ArgTag::U64: { uint64_t v; take(v); visit(v); break; }
+            case ArgTag::F32: { float v; take(v); visit(v); break; }
+            case ArgTag::F64: { double v; take(v); visit(v); break; }
+            case ArgTag::BOOL: { bool v; take(v); visit(v); break; }
+            case ArgTag::CHAR: { char v; take(v); visit(v); break; }
+            case ArgTag::PTR: { const void* v; take(v); visit(v); break; }
+            case ArgTag::STR: {
+                uint32_t n;
+                take(n);
+                visit(std::string_view(p, n));
+                p += n;
+                break;
+            }
+        }
+    };
+
+    if (site.format.empty()) {
+        while (p < end) next([&out](const auto& v) { AppendFormatted(out, v); });
+        return;
+    }
+    // The store is reused, so it stops allocating once warm. It copies no strings: string
+    // views are kept as views into the record.
+    thread_local fmt::dynamic_format_arg_store<fmt::format_context> args;
+    args.clear();
+    while (p < end) next([](const auto& v) { args.push_back(v); });
+    try {
+        fmt::vformat_to(std::back_inserter(out), fmt::string_view(site.format.data(), site.format.size()), args);
+    } catch (const fmt::format_error& e) {
+        fmt::format_to(std::back_inserter(out), "<format error: {}> {}", e.what(), site.format);
+    }
+}
+
+}  // namespace detail
+
+// Single-producer single-consumer byte ring of whole deferred records. A record never
+// wraps: when it does not fit before the end, the rest of the ring is skipped with a
+// padding record.
+class LogRing {
+   public:
+    explicit LogRing(size_t capacity) {
+        size_t cap = round_capacity(capacity);
+        mask_ = cap - 1;
+        // slack past the end, so a padding header written into the last 8 bytes fits
+        buf_ = std::make_unique<char[]>(cap + sizeof(detail::RecordHeader));
+    }
+
+    // the capacity a ring asked for `capacity` bytes gets
+    static size_t round_capacity(size_t capacity) {
+        size_t cap = 4096;
+        while (cap < capacity) cap <<= 1;
+        return cap;
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // Producer side, once the consumer is gone for good (detached): empty the ring for a
+    // new consumer
+    void reset() {
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+        cached_tail_ = cached_head_ = 0;
+        detached.store(false, std::memory_order_relaxed);
+    }
+
+    // Producer side. `n` is a multiple of 8 and at most capacity() / 2.
+    bool push(const char* rec, size_t n) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t off = head & mask_;
+        size_t contig = capacity() - off;
+        size_t need = n <= contig ? n : contig + n;
+        if (need > capacity() - (head - cached_tail_)) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (need > capacity() - (head - cached_tail_)) return false;
+        }
+        if (n > contig) {
+            detail::RecordHeader pad{uint32_t(contig), uint32_t(contig), nullptr, 0};
+            std::memcpy(buf_.get() + off, &pad, sizeof(pad));
+            head += contig;
+            off = 0;
+        }
+        std::memcpy(buf_.get() + off, rec, n);
+        head_.store(head + n, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: front() only sees records published before the last refresh()
+    void refresh() { cached_head_ = head_.load(std::memory_order_acquire); }
+    const char* front() {
+        for (;;) {
+            size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail == cached_head_) return nullptr;
+            const char* p = buf_.get() + (tail & mask_);
+            detail::RecordHeader h;
+            std::memcpy(&h, p, sizeof(h));
+            if (h.site) return p;
+            tail_.store(tail + h.size, std::memory_order_release);
+        }
+    }
+    void pop(const char* rec) {
+        uint32_t size;
+        std::memcpy(&size, rec, sizeof(size));
+        tail_.store(tail_.load(std::memory_order_relaxed) + size, std::memory_order_release);
+    }
+
+    std::atomic<bool> closed{false};    // the producing thread has exited
+    std::atomic<bool> detached{false};  // the consuming backend has stopped
+
+   private:
+    size_t mask_;
+    std::unique_ptr<char[]> buf_;
+    alignas(64) std::atomic<size_t> head_{0};
+    size_t cached_tail_ = 0;
+    alignas(64) std::atomic<size_t> tail_{0};
+    size_t cached_head_ = 0;
+};
+
+// Deferred-formatting backend. A LOG() on the hot path copies a RecordHeader (call-site
+// pointer and timestamp) and its raw arguments into its thread's LogRing; nothing is
+// formatted and nothing is locked. One background thread merges the rings by timestamp,
+// formats each record and hands it to the logger with its original time. Lines from one
+// thread keep their order; lines from different threads are ordered within each pass.
+class DeferredLog {
+   public:
+    DeferredLog(std::shared_ptr<spdlog::logger> logger, size_t ring_size, bool block)
+        : logger_(std::move(logger)), ring_size_(ring_size), block_(block), id_(next_id()) {
+        thread_ = std::thread([this] { run(); });
+    }
+    ~DeferredLog() { stop(); }
+    DeferredLog(const DeferredLog&) = delete;
+    DeferredLog& operator=(const DeferredLog&) = delete;
+
+    // Hot path: start a record for `site` in `buf`
+    static void begin(LineBuffer& buf, const LogSite& site) {
+        detail::RecordHeader h{0, 0, &site, detail::Cycles()};
+        buf.resize(0);
+        detail::Put(buf, h);
+    }
+    // Hot path: publish a record started with begin(). False if it is too big for the
+    // ring; the caller then has to log it some other way.
+    bool commit(LineBuffer& buf) {
+        uint32_t len = uint32_t(buf.size());
+        uint32_t size = (len + 7) & ~uint32_t(7);
+        buf.resize(size);
+        std::memcpy(buf.data(), &size, sizeof(size));
+        std::memcpy(buf.data() + sizeof(size), &len, sizeof(len));
+
+        LogRing& ring = local_ring();
+        if (size > ring.capacity() / 2) return false;
+        while (!ring.push(buf.data(), size)) {
+            if (!block_ || stop_.load(std::memory_order_relaxed)) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    // Wait until every record committed before this call has reached the logger
+    void drain(std::chrono::milliseconds timeout = std::chrono::seconds(5)) {
+        std::unique_lock<std::mutex> lk(mu_);
+        uint64_t req = ++requested_;
+        cv_.notify_one();
+        done_.wait_for(lk, timeout, [&] { return completed_ >= req; });
+    }
+
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    // Write out everything committed so far and end the consumer thread. Records committed
+    // afterwards are dropped.
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            if (stop_) return;
+            stop_ = true;
+        }
+        cv_.notify_one();
+        thread_.join();
+        // the producing threads may now reuse their rings for another backend
+        std::lock_guard<std::mutex> lk(mu_);
+        for (auto& r : rings_) r->detached.store(true, std::memory_order_release);
+    }
+
+   private:
+    static constexpr auto kPollInterval = std::chrono::milliseconds(1);
+
+    // A thread's rings, one per backend it logs to, the last used first. A ring whose
+    // backend has stopped is reset and reused for the next backend, or freed.
+    struct local_rings {
+        struct entry {
+            uint64_t owner;
+            std::shared_ptr<LogRing> ring;
+        };
+        std::vector<entry> entries;
+        ~local_rings() {
+            for (auto& e : entries) e.ring->closed = true;
+        }
+    };
+
+    static uint64_t next_id() {
+        static std::atomic<uint64_t> id{0};
+        return ++id;
+    }
+
+    // The calling thread's ring for this backend, registered on first use
+    LogRing& local_ring() {
+        thread_local local_rings local;
+        auto& v = local.entries;
+        if (!v.empty() && v.front().owner == id_) return *v.front().ring;
+        return switch_ring(v);
+    }
+
+    LogRing& switch_ring(std::vector<local_rings::entry>& v) {
+        std::shared_ptr<LogRing> spare;
+        for (size_t i = 0; i < v.size();) {
+            if (v[i].owner == id_) {
+                std::rotate(v.begin(), v.begin() + long(i), v.begin() + long(i) + 1);
+                return *v.front().ring;
+            }
+            if (v[i].ring->detached.load(std::memory_order_acquire)) {
+                if (!spare && v[i].ring->capacity() == LogRing::round_capacity(ring_size_)) spare = v[i].ring;
+                v.erase(v.begin() + long(i));
+                continue;
+            }
+            ++i;
+        }
+        if (spare)
+            spare->reset();
+        else
+            spare = std::make_shared<LogRing>(ring_size_);
+        v.insert(v.begin(), {id_, spare});
+        std::lock_guard<std::mutex> lk(mu_);
+        rings_.push_back(std::move(spare));
+        return *v.front().ring;
+    }
+
+    void run() {
+        using namespace std::chrono;
+        // ns per Cycles() tick, from a short calibration, refined on every pass
+        auto c0 = detail::Cycles();
+        auto t0 = steady_clock::now();
+#if defined(__x86_64__) || defined(__i386__)
+        std::this_thread::sleep_for(milliseconds(2));
+        ns_per_cycle_ = double(duration_cast<nanoseconds>(steady_clock::now() - t0).count()) /
+                        double(std::max<uint64_t>(detail::Cycles() - c0, 1));
+#endif
+
+        std::unique_lock<std::mutex> lk(mu_);
+        for (;;) {
+            bool stopping = stop_;
+            uint64_t req = requested_;
+            rings_.erase(std::remove_if(rings_.begin(), rings_.end(),
+                                        [](const std::shared_ptr<LogRing>& r) {
+                                            if (!r->closed.load(std::memory_order_acquire)) return false;
+                                            r->refresh();
+                                            return r->front() == nullptr;
+                                        }),
+                         rings_.end());
+            active_ = rings_;
+            lk.unlock();
+
+#if defined(__x86_64__) || defined(__i386__)
+            auto elapsed = duration_cast<nanoseconds>(steady_clock::now() - t0).count();
+            if (elapsed > 100000000) ns_per_cycle_ = double(elapsed) / double(detail::Cycles() - c0);
+#endif
+            size_t n = pass();
+
+            lk.lock();
+            completed_ = req;
+            done_.notify_all();
+            if (stopping) break;
+            if (n == 0) cv_.wait_for(lk, kPollInterval, [&] { return stop_ || requested_ != completed_; });
+        }
+    }
+
+    // Format everything published so far, oldest timestamp first
+    size_t pass() {
+        uint64_t now_cycles = detail::Cycles();
+        auto now = spdlog::log_clock::now();
+        for (auto& r : active_) r->refresh();
+
+        size_t n = 0;
+        for (;;) {
+            LogRing* best = nullptr;
+            const char* rec = nullptr;
+            detail::RecordHeader h{}, bh{};
+            for (auto& r : active_) {
+                const char* p = r->front();
+                if (!p) continue;
+                std::memcpy(&h, p, sizeof(h));
+                if (!best || int64_t(h.cycles - bh.cycles) < 0) {
+                    best = r.get();
+                    rec = p;
+                    bh = h;
+                }
+            }
+            if (!best) break;
+
+            line_.clear();
+            detail::RenderRecord(rec, line_);
+            auto age = std::chrono::nanoseconds(int64_t(double(int64_t(now_cycles - bh.cycles)) * ns_per_cycle_));
+            logger_->log(std::chrono::time_point_cast<spdlog::log_clock::duration>(now - age), spdlog::source_loc{},
+                         static_cast<spdlog::level::level_enum>(bh.site->severity),
+                         spdlog::string_view_t(line_.data(), line_.size()));
+            best->pop(rec);
+            ++n;
+        }
+        return n;
+    }
+
+    std::shared_ptr<spdlog::logger> logger_;
+    size_t ring_size_;
+    bool block_;
+    uint64_t id_;
+    std::atomic<uint64_t> dropped_{0};
+
+    std::mutex mu_;
+    std::condition_variable cv_;    // wakes the consumer
+    std::condition_variable done_;  // a pass finished
+    std::vector<std::shared_ptr<LogRing>> rings_;
+    uint64_t requested_ = 0, completed_ = 0;
+    std::atomic<bool> stop_{false};  // written under mu_
+
+    // consumer thread only
+    std::vector<std::shared_ptr<LogRing>> active_;
+    LineBuffer line_;
+    double ns_per_cycle_ = 1.0;
+    std::thread thread_;
+};
+
+// A LogWrapper can outlive its publication in the per-thread snapshots of threads that
+// have not logged since (see getLogWrapper). InitLoggingCompat and ShutdownLoggingCompat
+// therefore retire() the wrapper they replace: its sinks, files and background threads
+// are released right away, and what is left for the snapshots is an empty shell whose
+// stragglers WriteLog forwards to the published wrapper.
 struct LogWrapper {
     LogConfig cfg_;
+    std::shared_ptr<spdlog::details::thread_pool> pool_;  // async only; atomic access, retire() resets it
+    std::shared_ptr<FlushSignalSink> flushed_;            // async only
+    std::shared_ptr<spdlog::sinks::dist_sink_mt> sinks_;  // every sink, emptied by retire()
     std::shared_ptr<spdlog::logger> logger_;
+    std::unique_ptr<DeferredLog> deferred_;  // deferred only; stopped before logger_ goes
+    std::atomic<uint64_t> dropped_{0};
+    std::shared_ptr<std::atomic<bool>> retired_ = std::make_shared<std::atomic<bool>>(false);
 
     using iterator = std::vector<spdlog::sink_ptr>::iterator;
     LogWrapper(const LogConfig& cfg, spdlog::sink_ptr sink)
-        : cfg_(cfg), logger_(std::make_shared<spdlog::logger>(cfg.progname, sink)) {}
+        : cfg_(cfg),
+          sinks_(std::make_shared<spdlog::sinks::dist_sink_mt>(std::vector<spdlog::sink_ptr>{std::move(sink)})),
+          logger_(std::make_shared<spdlog::logger>(cfg.progname, sinks_)) {
+        start_deferred();
+    }
     LogWrapper(const LogConfig& cfg, iterator begin, iterator end)
-        : cfg_(cfg), logger_(std::make_shared<spdlog::logger>(cfg.progname, begin, end)) {}
+        : cfg_(cfg), sinks_(std::make_shared<spdlog::sinks::dist_sink_mt>(std::vector<spdlog::sink_ptr>(begin, end))) {
+        if (!cfg.async) {
+            logger_ = std::make_shared<spdlog::logger>(cfg.progname, sinks_);
+            start_deferred();
+            return;
+        }
+        pool_ = std::make_shared<spdlog::details::thread_pool>(std::max<size_t>(cfg.async_queue_size, 1),
+                                                               std::max<size_t>(cfg.async_threads, 1));
+        // DROP is decided in WriteLog, before the message reaches the queue
+        auto policy = cfg.async_overflow == AsyncOverflow::OVERRUN_OLDEST ? spdlog::async_overflow_policy::overrun_oldest
+                                                                           : spdlog::async_overflow_policy::block;
+        flushed_ = std::make_shared<FlushSignalSink>();
+        sinks_->add_sink(flushed_);
+        logger_ = std::make_shared<spdlog::async_logger>(cfg.progname, sinks_, pool_, policy);
+        // a straggler racing retire() finds the pool gone; that is not worth a report
+        logger_->set_error_handler([retired = retired_, name = cfg.progname](const std::string& msg) {
+            if (!retired->load(std::memory_order_relaxed))
+                fmt::print(stderr, "[*** LOG ERROR ***] [{}] {}\n", name, msg);
+        });
+        start_deferred();
+    }
+
+    bool retired() const { return retired_->load(std::memory_order_acquire); }
+
+    std::shared_ptr<spdlog::details::thread_pool> pool() const { return std::atomic_load(&pool_); }
+
+    // Flush and, for deferred and async loggers, wait until everything logged before this
+    // call has been written
+    void drain(std::chrono::milliseconds timeout = std::chrono::seconds(5)) {
+        if (retired()) return;
+        if (deferred_) deferred_->drain(timeout);
+        if (!flushed_) {
+            logger_->flush();
+            return;
+        }
+        uint64_t seen = flushed_->flushes();
+        logger_->flush();
+        flushed_->wait_past(seen, timeout);
+    }
+
+    // Drain, then release the sinks (closing their files) and stop the background threads.
+    // Idempotent. The wrapper stays valid for threads still holding it; they log nothing.
+    void retire() {
+        drain();
+        if (retired_->exchange(true, std::memory_order_acq_rel)) return;
+        if (deferred_) deferred_->stop();
+        std::atomic_store(&pool_, std::shared_ptr<spdlog::details::thread_pool>());  // joins after the queue
+        std::vector<spdlog::sink_ptr> sinks = sinks_->sinks();
+        sinks_->set_sinks({});
+        sinks.clear();  // outside the dist sink's lock: destructors may join threads
+    }
+
+   private:
+    void start_deferred() {
+        if (cfg_.deferred)
+            deferred_ = std::make_unique<DeferredLog>(logger_, cfg_.deferred_ring_size,
+                                                      cfg_.async_overflow == AsyncOverflow::BLOCK);
+    }
+};
+
+// Per-thread line buffers, reused so an enabled LOG() does not allocate once warm. A LOG()
+// reached while evaluating another one's operands takes the next buffer in the stack.
+class LogBuffer {
+   public:
+    using buffer = LineBuffer;
+
+    LogBuffer() : pool_(local()) {
+        if (pool_.depth < kDepth) {
+            buf_ = &pool_.bufs[pool_.depth];
+        } else {
+            own_ = std::make_unique<buffer>();
+            buf_ = own_.get();
+        }
+        ++pool_.depth;
+        buf_->clear();
+    }
+    ~LogBuffer() {
+        --pool_.depth;
+        // don't pin the memory of one huge line for the thread's lifetime
+        if (!own_ && buf_->capacity() > kMaxRetained) *buf_ = buffer();
+    }
+    LogBuffer(const LogBuffer&) = delete;
+    LogBuffer& operator=(const LogBuffer&) = delete;
+
+    buffer& get() { return *buf_; }
+    std::string_view view() const { return std::string_view(buf_->data(), buf_->size()); }
+
+    // LOG() statements in progress on this thread
+    static int depth() { return local().depth; }
+
+   private:
+    static constexpr int kDepth = 4;
+    static constexpr size_t kMaxRetained = 64 * 1024;
+
+    struct pool {
+        buffer bufs[kDepth];
+        int depth = 0;
+    };
+    static pool& local() {
+        thread_local pool p;
+        return p;
+    }
+
+    pool& pool_;
+    buffer* buf_;
+    std::unique_ptr<buffer> own_;
+};
+
+namespace detail {
+
+// The published logger. LOG() reads the level with one relaxed load; the wrapper itself
+// is read through a per-thread snapshot (see getLogWrapper) that is refreshed when the
+// generation moves, so readers never touch a shared reference count.
+inline std::atomic<int> gLogLevel{static_cast<int>(LogSeverity::INFO)};
+inline std::atomic<uint64_t> gLoggerGeneration{1};
+
+// Lowest level enabled anywhere, plus kVModuleOn while vmodule rules exist. Call sites
+// cache their own level against gVModuleGeneration, which moves on every level change.
+constexpr int kVModuleOn = 0x100;
+inline std::atomic<int> gLogGate{static_cast<int>(LogSeverity::INFO)};
+inline std::atomic<uint64_t> gVModuleGeneration{1};
+
+struct VModuleRule {
+    std::string pattern;
+    LogSeverity level;
 };
 
-inline std::shared_ptr<LogWrapper>& getLogWrapper() {
-    static std::shared_ptr<LogWrapper> wrapper = [] {
-        LogConfig cfg;
-        cfg.progname = "default";
-        cfg.log_to_stderr = true;
-        cfg.log_file.clear();
+struct LoggerSlot {
+    std::mutex mu;
+    std::shared_ptr<LogWrapper> current;
+    std::vector<VModuleRule> vmodule;
+};
 
-        auto sink = std::make_shared<spdlog::sinks::stderr_color_sink_mt>();
-        sink->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%^%l%$] %v");
+// '*' and '?' wildcards
+inline bool GlobMatch(std::string_view pat, std::string_view s) {
+    size_t p = 0, i = 0, star = std::string_view::npos, mark = 0;
+    while (i < s.size()) {
+        if (p < pat.size() && (pat[p] == '?' || pat[p] == s[i])) {
+            ++p;
+            ++i;
+        } else if (p < pat.size() && pat[p] == '*') {
+            star = p++;
+            mark = i;
+        } else if (star != std::string_view::npos) {
+            p = star + 1;
+            i = ++mark;
+        } else {
+            return false;
+        }
+    }
+    while (p < pat.size() && pat[p] == '*') ++p;
+    return p == pat.size();
+}
 
-        auto w = std::make_shared<LogWrapper>(cfg, sink);
-        w->logger_->set_level(spdlog::level::info);
-        w->logger_->flush_on(spdlog::level::err);
-        return w;
-    }();
+inline bool VModuleMatches(std::string_view pattern, std::string_view path) {
+    if (pattern.find('/') != std::string_view::npos) {
+        // anchored at a directory boundary: "net/*" matches ".../net/uri.h"
+        if (GlobMatch(pattern, path)) return true;
+        for (size_t at = path.find('/'); at != std::string_view::npos; at = path.find('/', at + 1))
+            if (GlobMatch(pattern, path.substr(at + 1))) return true;
+        return false;
+    }
+    std::string_view file = path.substr(path.rfind('/') + 1);
+    return GlobMatch(pattern, file) || GlobMatch(pattern, file.substr(0, file.rfind('.')));
+}
 
-    return wrapper;
+inline bool ParseLogSeverity(std::string_view name, LogSeverity& out) {
+    static constexpr std::pair<std::string_view, LogSeverity> kNames[] = {
+        {"DEBUG", LogSeverity::DEBUG}, {"INFO", LogSeverity::INFO},   {"WARNING", LogSeverity::WARNING},
+        {"ERROR", LogSeverity::ERROR}, {"FATAL", LogSeverity::FATAL},
+    };
+    for (const auto& [n, sev] : kNames) {
+        if (name.size() == n.size() && std::equal(n.begin(), n.end(), name.begin(), [](char a, char b) {
+                return a == (b >= 'a' && b <= 'z' ? char(b - 32) : b);
+            })) {
+            out = sev;
+            return true;
+        }
+    }
+    return false;
+}
+
+// "pattern=LEVEL[,pattern=LEVEL...]"; all or nothing
+inline bool ParseVModule(std::string_view spec, std::vector<VModuleRule>& out) {
+    std::vector<VModuleRule> rules;
+    while (!spec.empty()) {
+        size_t comma = std::min(spec.find(','), spec.size());
+        std::string_view item = spec.substr(0, comma);
+        spec.remove_prefix(std::min(comma + 1, spec.size()));
+        if (item.empty()) continue;
+        size_t eq = item.rfind('=');
+        LogSeverity level;
+        if (eq == 0 || eq == std::string_view::npos || !ParseLogSeverity(item.substr(eq + 1), level)) return false;
+        rules.push_back({std::string(item.substr(0, eq)), level});
+    }
+    out = std::move(rules);
+    return true;
+}
+
+// Recompute the gate and invalidate every call site's cached level. Caller holds slot.mu.
+inline void UpdateLevelGate(LoggerSlot& slot) {
+    int floor = gLogLevel.load(std::memory_order_relaxed);
+    for (const auto& r : slot.vmodule) floor = std::min(floor, static_cast<int>(r.level));
+    gLogGate.store(floor | (slot.vmodule.empty() ? 0 : kVModuleOn), std::memory_order_relaxed);
+    gVModuleGeneration.fetch_add(1, std::memory_order_relaxed);
+    // spdlog filters too; let everything that passed our checks through
+    if (slot.current) slot.current->logger_->set_level(static_cast<spdlog::level::level_enum>(floor));
+}
+
+inline std::shared_ptr<LogWrapper> MakeDefaultLogWrapper() {
+    LogConfig cfg;
+    cfg.progname = "default";
+    cfg.log_to_stderr = true;
+    cfg.log_file.clear();
+
+    auto sink = std::make_shared<spdlog::sinks::stderr_color_sink_mt>();
+    sink->set_pattern(cfg.console_pattern);
+
+    auto w = std::make_shared<LogWrapper>(cfg, sink);
+    w->logger_->set_level(spdlog::level::info);
+    w->logger_->flush_on(spdlog::level::err);
+    return w;
+}
+
+inline LoggerSlot& GetLoggerSlot() {
+    static LoggerSlot slot{{}, MakeDefaultLogWrapper(), {}};
+    return slot;
+}
+
+// The published wrapper itself, bypassing this thread's snapshot
+inline std::shared_ptr<LogWrapper> PublishedLogWrapper() {
+    auto& slot = GetLoggerSlot();
+    std::lock_guard<std::mutex> lk(slot.mu);
+    return slot.current;
+}
+
+}  // namespace detail
+
+// This thread's view of the published LogWrapper (may be null after shutdown). The
+// snapshot is only refreshed between statements, so a wrapper replaced while a LOG() is
+// in progress stays alive until that statement and any nested in it are done; the old
+// wrapper is destroyed once every thread has moved on or exited. Its resources do not
+// wait for that when it was replaced by InitLoggingCompat: see LogWrapper::retire().
+inline const std::shared_ptr<LogWrapper>& getLogWrapper() {
+    thread_local std::shared_ptr<LogWrapper> local;
+    thread_local uint64_t seen = 0;
+    uint64_t gen = detail::gLoggerGeneration.load(std::memory_order_acquire);
+    if (gen != seen && (seen == 0 || LogBuffer::depth() == 0)) {
+        std::shared_ptr<LogWrapper> old;
+        {
+            auto& slot = detail::GetLoggerSlot();
+            std::lock_guard<std::mutex> lk(slot.mu);
+            old = std::exchange(local, slot.current);
+            seen = detail::gLoggerGeneration.load(std::memory_order_relaxed);
+        }
+        // `old` may be the last reference; it is released here, outside the lock
+    }
+    return local;
+}
+
+// Publish `lw` (null turns logging off) and take the level and vmodule rules from its
+// config (an invalid vmodule spec means no rules). Other threads switch over at their
+// next statement. Returns the wrapper it replaced.
+inline std::shared_ptr<LogWrapper> SetLogWrapper(std::shared_ptr<LogWrapper> lw) {
+    {
+        auto& slot = detail::GetLoggerSlot();
+        std::lock_guard<std::mutex> lk(slot.mu);
+        if (lw) {
+            detail::gLogLevel.store(static_cast<int>(lw->cfg_.log_level), std::memory_order_relaxed);
+            if (!detail::ParseVModule(lw->cfg_.vmodule, slot.vmodule)) slot.vmodule.clear();
+        }
+        std::swap(slot.current, lw);
+        detail::UpdateLevelGate(slot);
+        detail::gLoggerGeneration.fetch_add(1, std::memory_order_release);
+    }
+    getLogWrapper();  // the caller lets go of the old wrapper right away
+    return lw;
+}
+
+inline LogSeverity GetLogLevel() {
+    return static_cast<LogSeverity>(detail::gLogLevel.load(std::memory_order_relaxed));
+}
+
+// Takes effect immediately on every thread
+inline void SetLogLevel(LogSeverity severity) {
+    auto& slot = detail::GetLoggerSlot();
+    std::lock_guard<std::mutex> lk(slot.mu);
+    detail::gLogLevel.store(static_cast<int>(severity), std::memory_order_relaxed);
+    detail::UpdateLevelGate(slot);
+}
+
+// Replace the vmodule rules, e.g. SetVModule("uri_*=DEBUG"); "" removes them. Rules are
+// tried in order and the first match wins. Returns false, changing nothing, on a bad spec.
+inline bool SetVModule(std::string_view spec) {
+    std::vector<detail::VModuleRule> rules;
+    if (!detail::ParseVModule(spec, rules)) return false;
+    auto& slot = detail::GetLoggerSlot();
+    std::lock_guard<std::mutex> lk(slot.mu);
+    slot.vmodule = std::move(rules);
+    detail::UpdateLevelGate(slot);
+    return true;
+}
+
+// Applies to every sink of the published logger; safe while other threads log
+inline void SetLogPattern(const std::string& pattern) {
+    auto& slot = detail::GetLoggerSlot();
+    std::lock_guard<std::mutex> lk(slot.mu);
+    if (slot.current) slot.current->logger_->set_pattern(pattern);
 }
 
 // -lspdlog -lfmt
+// May be called again to reconfigure a running process: the new logger is built, then
+// published, then the old one is drained and retired.
 inline void InitLoggingCompat(const LogConfig& cfg) {
-    static std::once_flag once;
-    std::call_once(once, [&] {
-        std::vector<spdlog::sink_ptr> sinks;
-        if (cfg.log_to_stderr) {
-            auto console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
-            console_sink->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%^%l%$] %v");
-            sinks.push_back(console_sink);
-        }
+    std::vector<spdlog::sink_ptr> sinks;
+    if (cfg.log_to_stderr) {
+        auto console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+        console_sink->set_pattern(cfg.console_pattern);
+        sinks.push_back(console_sink);
+    }
 
-        if (!cfg.log_file.empty()) {
-            auto file_sink =
+    if (!cfg.log_file.empty()) {
+        spdlog::sink_ptr file_sink;
+        if (cfg.log_file_mmap)
+            file_sink = std::make_shared<MmapFileSink>(cfg.log_file, cfg.max_file_size, cfg.max_files,
+                                                       cfg.log_file_compression);
+        else if (cfg.log_file_compression != LogCompression::NONE)
+            file_sink = std::make_shared<ArchivingFileSink>(cfg.log_file, cfg.max_file_size, cfg.max_files,
+                                                            cfg.log_file_compression);
+        else
+            file_sink =
                 std::make_shared<spdlog::sinks::rotating_file_sink_mt>(cfg.log_file, cfg.max_file_size, cfg.max_files);
-            file_sink->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%l] %v");
-            sinks.push_back(file_sink);
-        }
+        file_sink->set_pattern(cfg.file_pattern);
+        sinks.push_back(file_sink);
+    }
 
-        auto lw = std::make_shared<LogWrapper>(cfg, sinks.begin(), sinks.end());
-        lw->logger_->set_level(static_cast<spdlog::level::level_enum>(cfg.log_level));
-        lw->logger_->flush_on(spdlog::level::err);
+    auto lw = std::make_shared<LogWrapper>(cfg, sinks.begin(), sinks.end());
+    lw->logger_->set_level(static_cast<spdlog::level::level_enum>(cfg.log_level));
+    lw->logger_->flush_on(spdlog::level::err);
 
-        spdlog::register_logger(lw->logger_);
-        getLogWrapper().swap(lw);
-    });
+    auto logger = lw->logger_;
+    if (auto old = SetLogWrapper(std::move(lw))) {
+        old->retire();
+        spdlog::drop(old->logger_->name());
+    }
+    spdlog::drop(logger->name());
+    spdlog::register_logger(logger);
 }
 
 inline void ShutdownLoggingCompat() {
-    static std::once_flag once;
-    auto& lw = getLogWrapper();
-    if (lw) {
-        std::call_once(once, [&] {
-            lw->logger_->flush();
-            spdlog::drop(lw->logger_->name());
-            lw.reset();
-        });
+    if (auto lw = SetLogWrapper(nullptr)) {
+        lw->retire();
+        spdlog::drop(lw->logger_->name());
     }
 }
 
-class LogStream {
-   public:
-    LogStream(LogSeverity severity, const char* file, int line) : loglevel_(severity), file_(file), line_(line) {
-        stream_ << "[" << file_ << ":" << line_ << "] ";
+inline LogStats GetLogStats() {
+    LogStats st;
+    if (auto& lw = getLogWrapper()) {
+        st.dropped = lw->dropped_.load(std::memory_order_relaxed);
+        if (lw->deferred_) st.dropped += lw->deferred_->dropped();
+        if (auto pool = lw->pool()) st.overrun = pool->overrun_counter();
     }
+    return st;
+}
 
-    ~LogStream() {
-        auto& lw = getLogWrapper();
-        if (!lw) return;
+// Could `severity` be on anywhere? Exact when there are no vmodule rules.
+inline bool IsLogOn(LogSeverity severity) {
+    return static_cast<int>(severity) >= (detail::gLogGate.load(std::memory_order_relaxed) & 0xff);
+}
+
+namespace detail {
+
+// Slow path of IsLogOn(site): match the site against the rules and cache the result
+inline int ResolveSiteLevel(const LogSite& site) {
+    auto& slot = GetLoggerSlot();
+    std::lock_guard<std::mutex> lk(slot.mu);
+    int level = gLogLevel.load(std::memory_order_relaxed);
+    for (const auto& r : slot.vmodule) {
+        if (VModuleMatches(r.pattern, site.path)) {
+            level = static_cast<int>(r.level);
+            break;
+        }
+    }
+    site.level_cache.store(gVModuleGeneration.load(std::memory_order_relaxed) << 8 | uint64_t(level),
+                           std::memory_order_relaxed);
+    return level;
+}
 
-        // fast return
-        if (loglevel_ < lw->cfg_.log_level) return;
+}  // namespace detail
 
-        lw->logger_->log(static_cast<spdlog::level::level_enum>(loglevel_), stream_.str());
-        if (loglevel_ == LogSeverity::FATAL) {
+// Runtime half of the level check, done before any LogStream exists. Without vmodule
+// rules this is one relaxed load; with them, the site's cached level is used until the
+// rules or the level change.
+inline bool IsLogOn(const LogSite& site) {
+    int gate = detail::gLogGate.load(std::memory_order_relaxed);
+    int sev = static_cast<int>(site.severity);
+    if (sev < (gate & 0xff)) return false;
+    if (!(gate & detail::kVModuleOn)) return true;
+    uint64_t cached = site.level_cache.load(std::memory_order_relaxed);
+    if (cached >> 8 != detail::gVModuleGeneration.load(std::memory_order_relaxed))
+        return sev >= detail::ResolveSiteLevel(site);
+    return sev >= static_cast<int>(cached & 0xff);
+}
+
+// Hand a finished line to spdlog; FATAL flushes and aborts
+inline void WriteLog(LogSeverity severity, std::string_view line) {
+    const std::shared_ptr<LogWrapper>* snapshot = &getLogWrapper();
+    std::shared_ptr<LogWrapper> published;
+    if (*snapshot && (*snapshot)->retired()) {
+        // a statement that started before InitLoggingCompat replaced its wrapper
+        published = detail::PublishedLogWrapper();
+        snapshot = &published;
+    }
+    auto& lw = *snapshot;
+    if (!lw) return;
+
+    // LOG() checks the level up front; this covers direct LogStream use
+    if (!IsLogOn(severity)) return;
+
+    spdlog::string_view_t msg(line.data(), line.size());
+    if (severity == LogSeverity::FATAL) {
+        if (lw->deferred_) lw->deferred_->drain();
+        if (lw->pool()) {
+            // write FATAL on this thread after draining the queue, so it can be neither
+            // dropped nor overrun and is on disk before abort()
+            lw->drain();
+            spdlog::logger sync(lw->logger_->name(), lw->logger_->sinks().begin(), lw->logger_->sinks().end());
+            sync.log(spdlog::level::critical, msg);
+            sync.flush();
+        } else {
+            lw->logger_->log(spdlog::level::critical, msg);
             lw->logger_->flush();
-            std::abort();
         }
+        std::abort();
+    }
+    if (lw->cfg_.async && lw->cfg_.async_overflow == AsyncOverflow::DROP) {
+        auto pool = lw->pool();
+        if (pool && pool->queue_size() >= lw->cfg_.async_queue_size) {
+            lw->dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    lw->logger_->log(static_cast<spdlog::level::level_enum>(severity), msg);
+}
+
+// A deferred record too big for its ring is formatted here instead, out of order
+inline void CommitDeferred(DeferredLog& deferred, LineBuffer& rec) {
+    if (deferred.commit(rec)) return;
+    LogBuffer line;
+    detail::RenderRecord(rec.data(), line.get());
+    detail::RecordHeader h;
+    std::memcpy(&h, rec.data(), sizeof(h));
+    WriteLog(h.site->severity, line.view());
+}
+
+// The deferred backend a statement at `site` should use, if any. FATAL is always written
+// on the calling thread.
+inline DeferredLog* DeferredFor(const LogSite& site) {
+    auto& lw = getLogWrapper();
+    if (!lw || !lw->deferred_ || site.severity == LogSeverity::FATAL || !IsLogOn(site.severity) || lw->retired())
+        return nullptr;
+    return lw->deferred_.get();
+}
+
+class LogStream {
+   public:
+    LogStream(LogSeverity severity, const char* file, int line) : loglevel_(severity) {
+        fmt::format_to(std::back_inserter(buf_.get()), "[{}:{}] ", file, line);
+    }
+    // With the deferred backend on, `<<` only records its operands
+    explicit LogStream(const LogSite& site) : loglevel_(site.severity), deferred_(DeferredFor(site)) {
+        if (deferred_)
+            DeferredLog::begin(buf_.get(), site);
+        else
+            fmt::format_to(std::back_inserter(buf_.get()), "[{}:{}] ", site.file, site.line);
+    }
+
+    ~LogStream() {
+        if (deferred_)
+            CommitDeferred(*deferred_, buf_.get());
+        else
+            WriteLog(loglevel_, buf_.view());
     }
 
+    // Formats with fmt, keeping iostream's rendering of bools (1/0) and floats (%g).
+    // Types fmt does not know go through their operator<<.
     template <typename T>
     LogStream& operator<<(const T& value) {
-        stream_ << value;
+        if (deferred_)
+            detail::EncodeArg(buf_.get(), value);
+        else
+            detail::AppendFormatted(buf_.get(), value);
+        return *this;
+    }
+
+    // Rate-limited statements note how many calls they skipped since their last line
+    LogStream& suppressed(uint64_t n) {
+        if (n) *this << "[suppressed " << n << "] ";
         return *this;
     }
 
    private:
-    int line_;
-    const char* file_;
-    std::ostringstream stream_;
     LogSeverity loglevel_;
+    DeferredLog* deferred_ = nullptr;
+    LogBuffer buf_;
+};
+
+// LOGF(): format straight into the thread's line buffer, or record the arguments for the
+// deferred backend
+template <typename... Args>
+void LogFormat(const LogSite& site, fmt::format_string<Args...> format, Args&&... args) {
+    DeferredLog* deferred = DeferredFor(site);  // before `buf`, which marks the statement in progress
+    LogBuffer buf;
+    if (deferred) {
+        DeferredLog::begin(buf.get(), site);
+        (detail::EncodeArg(buf.get(), args), ...);
+        CommitDeferred(*deferred, buf.get());
+        return;
+    }
+    auto out = std::back_inserter(buf.get());
+    fmt::format_to(out, "[{}:{}] ", site.file, site.line);
+    fmt::format_to(out, format, std::forward<Args>(args)...);
+    WriteLog(site.severity, buf.view());
+}
+
+// Per-call-site state of LOG_EVERY_N / LOG_FIRST_N / LOG_EVERY_T. Constant-initialized,
+// so the macros' function-local statics need no guard.
+struct LogRateState {
+    std::atomic<uint64_t> count{0};       // calls that passed the level check
+    std::atomic<uint64_t> suppressed{0};  // skipped since the last line
+    std::atomic<int64_t> next{0};         // LOG_EVERY_T: steady-clock ns of the next allowed line
+};
+
+// The rate deciders return -1 to skip the call, otherwise the number of calls skipped
+// since the previous line (to be reported with this one)
+inline int64_t LogEveryN(LogRateState& st, uint64_t n) {
+    if (st.count.fetch_add(1, std::memory_order_relaxed) % std::max<uint64_t>(n, 1) == 0)
+        return int64_t(st.suppressed.exchange(0, std::memory_order_relaxed));
+    st.suppressed.fetch_add(1, std::memory_order_relaxed);
+    return -1;
+}
+
+inline int64_t LogFirstN(LogRateState& st, uint64_t n) {
+    // past the limit, a plain load keeps the skipped path free of shared writes
+    if (st.count.load(std::memory_order_relaxed) >= n) return -1;
+    return st.count.fetch_add(1, std::memory_order_relaxed) < n ? 0 : -1;
+}
+
+inline int64_t LogEveryT(LogRateState& st, double seconds) {
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count();
+    int64_t next = st.next.load(std::memory_order_relaxed);
+    if (now < next || !st.next.compare_exchange_strong(next, now + int64_t(seconds * 1e9), std::memory_order_relaxed)) {
+        st.suppressed.fetch_add(1, std::memory_order_relaxed);
+        return -1;
+    }
+    return int64_t(st.suppressed.exchange(0, std::memory_order_relaxed));
+}
+
+// Turns `LogStream << ...` into void so it can sit in the false branch of the ternary in
+// LOG(); `&` binds looser than `<<` and tighter than `?:`.
+struct LogMessageVoidify {
+    void operator&(const LogStream&) {}
 };
 
 };  // namespace slog
 };  // namespace cpptools
 
-#define LOG(sev) ::cpptools::slog::LogStream(::cpptools::slog::LogSeverity::sev, __FILE__, __LINE__)
-#define CHECK(cond)                                                                               \
-    do {                                                                                          \
-        if (!(cond))                                                                              \
-            ::cpptools::slog::LogStream(::cpptools::slog::LogSeverity::FATAL, __FILE__, __LINE__) \
-                << "Check failed: " #cond " ";                                                    \
-    } while (0)
+// Is `sev` logged at `site`? Constant-folds to false below SLOG_MIN_LEVEL.
+#define SLOG_SITE_IS_ON(sev, site) \
+    (::cpptools::slog::LogSeverity::sev >= ::cpptools::slog::kMinLogLevel && ::cpptools::slog::IsLogOn(site))
+
+// Is `sev` logged here?
+#define SLOG_IS_ON(sev) SLOG_SITE_IS_ON(sev, SLOG_SITE(sev))
+
+// The statement's LogSite, constant-initialized in static storage (no guard variable)
+#define SLOG_SITE(sev, ...)                                                                    \
+    []() -> const ::cpptools::slog::LogSite& {                                                 \
+        static constinit ::cpptools::slog::LogSite site{                                       \
+            ::cpptools::slog::detail::Basename(__FILE__), __FILE__, __LINE__,                  \
+            ::cpptools::slog::LogSeverity::sev __VA_OPT__(, ::std::string_view(__VA_ARGS__))}; \
+        return site;                                                                           \
+    }()
+
+#define SLOG_STREAM(sev) ::cpptools::slog::LogStream(SLOG_SITE(sev))
+
+// The statement's one LogSite, bound to `slog_site_` for a single pass, so that the level
+// check, with its vmodule cache, and the record see the same object
+#define SLOG_WITH_SITE(sev, on, ...)                                                                                  \
+    for (const ::cpptools::slog::LogSite* slog_site_ = &SLOG_SITE(sev __VA_OPT__(, __VA_ARGS__)); slog_site_ && (on); \
+         slog_site_ = nullptr)
+
+// The level (and condition) are checked before the stream is built, so disabled
+// statements neither format nor evaluate their `<<` operands. Like the rest, these expand
+// to a statement that is safe in an unbraced if/else.
+#define LOG_IF(sev, cond)                                            \
+    SLOG_WITH_SITE(sev, SLOG_SITE_IS_ON(sev, *slog_site_) && (cond)) \
+    ::cpptools::slog::LogStream(*slog_site_)
+#define LOG(sev) LOG_IF(sev, true)
+
+// fmt-style: LOGF(INFO, "x={} y={}", x, y); the format string is checked at compile time
+#define LOGF(sev, format, ...)                                                  \
+    SLOG_WITH_SITE(sev, SLOG_SITE_IS_ON(sev, *slog_site_), format)              \
+    ::cpptools::slog::LogFormat(*slog_site_, format __VA_OPT__(, ) __VA_ARGS__)
+
+// glog-style rate limiting, counted per call site. Skipped calls build no stream and
+// evaluate no operands; the next line that gets through starts with "[suppressed N]".
+//   LOG_EVERY_N(WARNING, 100) << "backend down";   // 1st, 101st, 201st, ... call
+//   LOG_FIRST_N(INFO, 5) << "cache miss";           // first 5 calls only
+//   LOG_EVERY_T(ERROR, 2.5) << "retrying";          // at most once per 2.5 s
+#define SLOG_RATE_STATE()                            \
+    []() -> ::cpptools::slog::LogRateState& {        \
+        static ::cpptools::slog::LogRateState state; \
+        return state;                                \
+    }()
+#define SLOG_RATE_LIMITED(sev, decide)                                                                        \
+    SLOG_WITH_SITE(sev, true)                                                                                 \
+    for (int64_t slog_suppressed_ = SLOG_SITE_IS_ON(sev, *slog_site_) ? (decide) : -1; slog_suppressed_ >= 0; \
+         slog_suppressed_         = -1)                                                                       \
+    ::cpptools::slog::LogStream(*slog_site_).suppressed(uint64_t(slog_suppressed_))
+
+#define LOG_EVERY_N(sev, n) SLOG_RATE_LIMITED(sev, ::cpptools::slog::LogEveryN(SLOG_RATE_STATE(), (n)))
+#define LOG_FIRST_N(sev, n) SLOG_RATE_LIMITED(sev, ::cpptools::slog::LogFirstN(SLOG_RATE_STATE(), (n)))
+#define LOG_EVERY_T(sev, seconds) SLOG_RATE_LIMITED(sev, ::cpptools::slog::LogEveryT(SLOG_RATE_STATE(), (seconds)))
+
+// `cond` is always evaluated
+#define CHECK(cond) \
+    (cond) ? (void)0 : ::cpptools::slog::LogMessageVoidify() & SLOG_STREAM(FATAL) << "Check failed: " #cond " "
@@ -0,0 +1,37 @@
+// LOG() below SLOG_MIN_LEVEL must compile away, whatever the runtime level says
+#define SLOG_MIN_LEVEL SLOG_LEVEL_INFO
+
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+#include <spdlog/sinks/ostream_sink.h>
+
+#include "slog.h"
+
+using cpptools::slog::LogSeverity;
+
+static_assert(cpptools::slog::kMinLogLevel == LogSeverity::INFO);
+
+TEST(SlogMinLevelTest, LowerLevelsAreCompiledOut) {
+    std::ostringstream out;
+    auto               sink = std::make_shared<spdlog::sinks::ostream_sink_mt>(out);
+    sink->set_pattern("%l %v");
+    cpptools::slog::LogConfig cfg;
+    cfg.log_level = LogSeverity::DEBUG;
+    auto lw       = std::make_shared<cpptools::slog::LogWrapper>(cfg, sink);
+    lw->logger_->set_level(spdlog::level::debug);
+    auto saved = cpptools::slog::SetLogWrapper(lw);
+
+    int evaluated = 0;
+    LOG(DEBUG) << ++evaluated;
+    LOG(INFO) << "kept " << ++evaluated;
+    EXPECT_EQ(evaluated, 1);
+    EXPECT_FALSE(SLOG_IS_ON(DEBUG));
+    EXPECT_TRUE(SLOG_IS_ON(INFO));
+    EXPECT_EQ(out.str().find("debug"), std::string::npos);
+    EXPECT_NE(out.str().find("kept 1"), std::string::npos);
+
+    cpptools::slog::SetLogWrapper(saved);
+}
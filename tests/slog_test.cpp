@@ -0,0 +1,976 @@
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <spdlog/sinks/basic_file_sink.h>
+#include <spdlog/sinks/null_sink.h>
+#include <spdlog/sinks/ostream_sink.h>
+
+#include "slog.h"
+
+using cpptools::slog::LogConfig;
+using cpptools::slog::LogSeverity;
+using cpptools::slog::LogWrapper;
+
+namespace {
+std::atomic<long> allocations{0};
+std::atomic<long> large_allocations{0};  // a deferred ring or bigger
+}  // namespace
+
+void* operator new(size_t n) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (n >= (1 << 20)) large_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+// Routes the global logger into a string for the lifetime of the fixture
+class SlogTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        auto sink = std::make_shared<spdlog::sinks::ostream_sink_mt>(out_);
+        sink->set_pattern("%l %v");
+        LogConfig cfg;
+        cfg.log_level = LogSeverity::DEBUG;
+        auto lw       = std::make_shared<LogWrapper>(cfg, sink);
+        lw->logger_->set_level(spdlog::level::debug);
+        saved_ = cpptools::slog::SetLogWrapper(lw);
+    }
+    void TearDown() override { cpptools::slog::SetLogWrapper(saved_); }
+
+    void set_level(LogSeverity sev) { cpptools::slog::SetLogLevel(sev); }
+    std::string output() const { return out_.str(); }
+
+    std::ostringstream          out_;
+    std::shared_ptr<LogWrapper> saved_;
+};
+
+struct Point {
+    int x, y;
+};
+std::ostream& operator<<(std::ostream& os, const Point& p) { return os << "(" << p.x << "," << p.y << ")"; }
+
+int evaluated = 0;
+int touch() { return ++evaluated; }
+
+std::string read_file(const std::string& path) {
+    std::ifstream in(path);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+}  // namespace
+
+TEST_F(SlogTest, DisabledLevelsSkipOperands) {
+    set_level(LogSeverity::INFO);
+    evaluated = 0;
+    LOG(INFO) << "value " << touch();
+    EXPECT_EQ(evaluated, 1);
+    LOG(WARNING) << "warn " << touch();
+    EXPECT_EQ(evaluated, 2);
+    for (int i = 0; i < 100; ++i) LOG(DEBUG) << touch();
+    EXPECT_EQ(evaluated, 2);
+    EXPECT_NE(output().find("info [slog_test.cpp:"), std::string::npos);
+    EXPECT_NE(output().find("] value 1"), std::string::npos);
+    EXPECT_EQ(output().find("debug"), std::string::npos);
+
+    LOG_IF(INFO, evaluated > 100) << touch();
+    EXPECT_EQ(evaluated, 2);
+    LOG_IF(INFO, evaluated == 2) << "cond " << touch();
+    EXPECT_EQ(evaluated, 3);
+    EXPECT_NE(output().find("cond 3"), std::string::npos);
+}
+
+TEST_F(SlogTest, MacrosAreSingleExpressions) {
+    // no dangling-else surprises
+    bool hit = false;
+    if (hit)
+        LOG(INFO) << "not reached";
+    else
+        hit = true;
+    EXPECT_TRUE(hit);
+
+    int checks = 0;
+    CHECK(++checks == 1) << "never printed";
+    EXPECT_EQ(checks, 1);
+}
+
+TEST_F(SlogTest, CheckFailureAborts) {
+    EXPECT_DEATH(CHECK(1 + 1 == 3) << "math", "");
+}
+
+TEST_F(SlogTest, FormatsLikeIostreams) {
+    LOG(INFO) << "b=" << true << " f=" << 0.1 + 0.2 << " c=" << 'x' << " s=" << std::string("str");
+    LOGF(INFO, "x={} y={:>3}", 7, "ab");
+    LOG(INFO) << "p=" << Point{1, 2};
+    EXPECT_NE(output().find("] p=(1,2)\n"), std::string::npos);
+    EXPECT_NE(output().find("] b=1 f=0.3 c=x s=str\n"), std::string::npos);
+    EXPECT_NE(output().find("] x=7 y= ab\n"), std::string::npos);
+
+    // longer than the inline buffer
+    std::string big(5000, 'z');
+    LOG(INFO) << big;
+    LOGF(INFO, "{}", big);
+    EXPECT_NE(output().find("] " + big + "\n"), output().rfind("] " + big + "\n"));
+}
+
+TEST_F(SlogTest, NestedStatementsGetTheirOwnBuffer) {
+    auto inner = [] {
+        LOG(INFO) << "inner";
+        return 42;
+    };
+    LOG(INFO) << "outer " << inner() << " done";
+    EXPECT_NE(output().find("] inner\n"), std::string::npos);
+    EXPECT_NE(output().find("] outer 42 done\n"), std::string::npos);
+}
+
+TEST_F(SlogTest, NoAllocationsOnceWarm) {
+    auto sink = std::make_shared<spdlog::sinks::null_sink_mt>();
+    LogConfig cfg;
+    cfg.log_level = LogSeverity::DEBUG;
+    auto lw       = std::make_shared<LogWrapper>(cfg, sink);
+    lw->logger_->set_level(spdlog::level::debug);
+    cpptools::slog::SetLogWrapper(lw);
+
+    auto emit = [](int i) {
+        LOG(INFO) << "request " << i << " took " << 1.5 << "ms";
+        LOGF(INFO, "request {} took {}ms", i, 1.5);
+    };
+    emit(0);  // warm the thread's buffers
+    long before = allocations.load();
+    for (int i = 0; i < 1000; ++i) emit(i);
+    EXPECT_EQ(allocations.load() - before, 0);
+}
+
+namespace {
+
+// counts lines and takes its time writing them
+class SlowSink final : public spdlog::sinks::base_sink<std::mutex> {
+   public:
+    explicit SlowSink(std::chrono::microseconds delay) : delay_(delay) {}
+    std::atomic<int> lines{0};
+
+   protected:
+    void sink_it_(const spdlog::details::log_msg&) override {
+        std::this_thread::sleep_for(delay_);
+        ++lines;
+    }
+    void flush_() override {}
+
+   private:
+    std::chrono::microseconds delay_;
+};
+
+std::shared_ptr<LogWrapper> make_async(std::vector<spdlog::sink_ptr> sinks, size_t queue,
+                                       cpptools::slog::AsyncOverflow policy) {
+    LogConfig cfg;
+    cfg.async            = true;
+    cfg.async_queue_size = queue;
+    cfg.async_overflow   = policy;
+    auto lw              = std::make_shared<LogWrapper>(cfg, sinks.begin(), sinks.end());
+    lw->logger_->set_level(spdlog::level::debug);
+    return lw;
+}
+
+}  // namespace
+
+TEST_F(SlogTest, AsyncBlockDeliversEverything) {
+    auto sink = std::make_shared<SlowSink>(std::chrono::microseconds(10));
+    auto lw   = make_async({sink}, 8, cpptools::slog::AsyncOverflow::BLOCK);
+    cpptools::slog::SetLogWrapper(lw);
+    for (int i = 0; i < 200; ++i) LOGF(INFO, "line {}", i);
+    lw->drain();
+    EXPECT_EQ(sink->lines, 200);
+    EXPECT_EQ(cpptools::slog::GetLogStats().dropped, 0u);
+    EXPECT_EQ(cpptools::slog::GetLogStats().overrun, 0u);
+}
+
+TEST_F(SlogTest, AsyncDropAndOverrunAreCounted) {
+    auto slow = std::make_shared<SlowSink>(std::chrono::milliseconds(1));
+    auto lw   = make_async({slow}, 4, cpptools::slog::AsyncOverflow::DROP);
+    cpptools::slog::SetLogWrapper(lw);
+    for (int i = 0; i < 100; ++i) LOG(INFO) << i;
+    lw->drain();
+    auto st = cpptools::slog::GetLogStats();
+    EXPECT_GT(st.dropped, 0u);
+    EXPECT_EQ(slow->lines + int(st.dropped), 100);
+
+    slow = std::make_shared<SlowSink>(std::chrono::milliseconds(1));
+    lw   = make_async({slow}, 4, cpptools::slog::AsyncOverflow::OVERRUN_OLDEST);
+    cpptools::slog::SetLogWrapper(lw);
+    for (int i = 0; i < 100; ++i) LOG(INFO) << i;
+    lw->drain();
+    st = cpptools::slog::GetLogStats();
+    EXPECT_GT(st.overrun, 0u);
+    EXPECT_EQ(st.dropped, 0u);
+}
+
+TEST_F(SlogTest, AsyncFatalIsWrittenBeforeAbort) {
+    std::string path = ::testing::TempDir() + "slog_async_fatal.log";
+    std::remove(path.c_str());
+    EXPECT_DEATH(
+        {
+            auto file = std::make_shared<spdlog::sinks::basic_file_sink_mt>(path, true);
+            auto slow = std::make_shared<SlowSink>(std::chrono::milliseconds(1));
+            auto lw   = make_async({slow, file}, 1024, cpptools::slog::AsyncOverflow::DROP);
+            cpptools::slog::SetLogWrapper(lw);
+            for (int i = 0; i < 50; ++i) LOG(INFO) << "queued " << i;
+            LOG(FATAL) << "the end";
+        },
+        "");
+    std::ifstream in(path);
+    std::string   text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_NE(text.find("queued 49"), std::string::npos);
+    EXPECT_NE(text.find("the end"), std::string::npos);
+    EXPECT_LT(text.find("queued 49"), text.find("the end"));
+}
+
+namespace {
+
+// keeps every message with its timestamp
+class CaptureSink final : public spdlog::sinks::base_sink<std::mutex> {
+   public:
+    struct line {
+        spdlog::log_clock::time_point time;
+        std::string text;
+    };
+    std::vector<line> lines;
+
+   protected:
+    void sink_it_(const spdlog::details::log_msg& msg) override {
+        lines.push_back({msg.time, std::string(msg.payload.data(), msg.payload.size())});
+    }
+    void flush_() override {}
+};
+
+std::shared_ptr<LogWrapper> make_deferred(std::vector<spdlog::sink_ptr> sinks, size_t ring,
+                                          cpptools::slog::AsyncOverflow policy) {
+    LogConfig cfg;
+    cfg.log_level          = LogSeverity::DEBUG;
+    cfg.deferred           = true;
+    cfg.deferred_ring_size = ring;
+    cfg.async_overflow     = policy;
+    auto lw                = std::make_shared<LogWrapper>(cfg, sinks.begin(), sinks.end());
+    lw->logger_->set_level(spdlog::level::debug);
+    return lw;
+}
+
+// message text after the "[file:line] " prefix
+std::string body(const std::string& line) { return line.substr(line.find("] ") + 2); }
+
+}  // namespace
+
+TEST_F(SlogTest, DeferredFormatsLikeImmediate) {
+    auto cap = std::make_shared<CaptureSink>();
+    auto lw  = make_deferred({cap}, 1 << 16, cpptools::slog::AsyncOverflow::BLOCK);
+    cpptools::slog::SetLogWrapper(lw);
+
+    const char* null = nullptr;
+    std::string s    = "str";
+    LOG(INFO) << "n=" << 42 << " u=" << 7u << " f=" << 1.5 << ' ' << true << Point{1, 2} << null << s;
+    LOGF(WARNING, "{:>4}|{:x}|{:.2f}|{}|{}", 7, 255u, 3.14159, "lit", s);
+    LOGF(INFO, "no args");
+    LOG(DEBUG) << 0.1f << int8_t(-3) << uint64_t(1) << std::string_view("view");
+    lw->drain();
+
+    ASSERT_EQ(cap->lines.size(), 4u);
+    EXPECT_EQ(cap->lines[0].text.rfind("[slog_test.cpp:", 0), 0u);
+    EXPECT_EQ(body(cap->lines[0].text), "n=42 u=7 f=1.5 1(1,2)(null)str");
+    EXPECT_EQ(body(cap->lines[1].text), "   7|ff|3.14|lit|str");
+    EXPECT_EQ(body(cap->lines[2].text), "no args");
+    EXPECT_EQ(body(cap->lines[3].text), "0.1-31view");
+}
+
+TEST_F(SlogTest, DeferredKeepsThreadOrderAndCallTime) {
+    auto cap = std::make_shared<CaptureSink>();
+    auto lw  = make_deferred({cap}, 1 << 12, cpptools::slog::AsyncOverflow::BLOCK);
+    cpptools::slog::SetLogWrapper(lw);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+        threads.emplace_back([t] {
+            for (int i = 0; i < 2000; ++i) LOGF(INFO, "{} {}", t, i);
+        });
+    for (auto& th : threads) th.join();
+    lw->drain();
+    ASSERT_EQ(cap->lines.size(), 8000u);
+    int next[4] = {0, 0, 0, 0};
+    for (const auto& l : cap->lines) {
+        int t = 0, i = 0;
+        ASSERT_EQ(std::sscanf(body(l.text).c_str(), "%d %d", &t, &i), 2);
+        EXPECT_EQ(i, next[t]++);
+    }
+
+    // lines carry the time of the call, not of the formatting
+    cap->lines.clear();
+    auto before = spdlog::log_clock::now();
+    LOG(INFO) << "first";
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    LOG(INFO) << "second";
+    lw->drain();
+    ASSERT_EQ(cap->lines.size(), 2u);
+    EXPECT_LT(cap->lines[0].time - before, std::chrono::milliseconds(20));
+    EXPECT_GT(cap->lines[1].time - cap->lines[0].time, std::chrono::milliseconds(40));
+}
+
+TEST_F(SlogTest, DeferredDropsWhenTheRingIsFull) {
+    auto slow = std::make_shared<SlowSink>(std::chrono::milliseconds(1));
+    auto lw   = make_deferred({slow}, 4096, cpptools::slog::AsyncOverflow::DROP);
+    cpptools::slog::SetLogWrapper(lw);
+    for (int i = 0; i < 1000; ++i) LOG(INFO) << "line " << i;
+    lw->drain(std::chrono::seconds(30));
+    auto st = cpptools::slog::GetLogStats();
+    EXPECT_GT(st.dropped, 0u);
+    EXPECT_EQ(slow->lines + int(st.dropped), 1000);
+}
+
+TEST_F(SlogTest, DeferredHotPathDoesNotAllocate) {
+    auto lw = make_deferred({std::make_shared<spdlog::sinks::null_sink_mt>()}, 1 << 20,
+                            cpptools::slog::AsyncOverflow::BLOCK);
+    cpptools::slog::SetLogWrapper(lw);
+    std::string s(100, 'x');
+    for (int i = 0; i < 10; ++i) {
+        LOG(INFO) << "warm " << i << s;
+        LOGF(INFO, "warm {} {} {}", i, 2.5, s);
+    }
+    lw->drain();
+
+    long before = allocations.load();
+    for (int i = 0; i < 1000; ++i) {
+        LOG(INFO) << "value " << i << ' ' << 2.5 << s;
+        LOGF(INFO, "value {} {} {}", i, 2.5, s);  // formatted from the record, strings not copied
+    }
+    lw->drain();
+    EXPECT_EQ(allocations.load() - before, 0);
+}
+
+TEST_F(SlogTest, DeferredRingsAreKeptPerBackend) {
+    auto a = make_deferred({std::make_shared<spdlog::sinks::null_sink_mt>()}, 1 << 20,
+                           cpptools::slog::AsyncOverflow::BLOCK);
+    auto b = make_deferred({std::make_shared<spdlog::sinks::null_sink_mt>()}, 1 << 20,
+                           cpptools::slog::AsyncOverflow::BLOCK);
+    cpptools::slog::SetLogWrapper(a);
+    LOG(INFO) << "a";
+    cpptools::slog::SetLogWrapper(b);
+    LOG(INFO) << "b";
+
+    // switching back and forth finds the thread's ring for each backend
+    long before = large_allocations.load();
+    for (int i = 0; i < 10; ++i) {
+        cpptools::slog::SetLogWrapper(a);
+        LOG(INFO) << "a " << i;
+        cpptools::slog::SetLogWrapper(b);
+        LOG(INFO) << "b " << i;
+    }
+    EXPECT_EQ(large_allocations.load() - before, 0);
+
+    // a stopped backend's ring is reused by the next one
+    a->retire();
+    auto cap = std::make_shared<CaptureSink>();
+    auto c   = make_deferred({cap}, 1 << 20, cpptools::slog::AsyncOverflow::BLOCK);
+    before   = large_allocations.load();
+    cpptools::slog::SetLogWrapper(c);
+    LOG(INFO) << "c";
+    EXPECT_EQ(large_allocations.load() - before, 0);
+    c->drain();
+    ASSERT_EQ(cap->lines.size(), 1u);
+    EXPECT_EQ(body(cap->lines[0].text), "c");
+}
+
+TEST_F(SlogTest, DeferredLinesPrecedeFatal) {
+    std::string path = ::testing::TempDir() + "slog_deferred_fatal.log";
+    std::remove(path.c_str());
+    EXPECT_DEATH(
+        {
+            auto file = std::make_shared<spdlog::sinks::basic_file_sink_mt>(path, true);
+            auto lw   = make_deferred({file}, 1 << 16, cpptools::slog::AsyncOverflow::BLOCK);
+            cpptools::slog::SetLogWrapper(lw);
+            for (int i = 0; i < 50; ++i) LOG(INFO) << "deferred " << i;
+            CHECK(1 + 1 == 3);
+        },
+        "");
+    std::ifstream in(path);
+    std::string   text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_NE(text.find("deferred 49"), std::string::npos);
+    EXPECT_NE(text.find("Check failed: 1 + 1 == 3"), std::string::npos);
+    EXPECT_LT(text.find("deferred 49"), text.find("Check failed"));
+}
+
+TEST_F(SlogTest, EveryNReportsSuppressedCalls) {
+    evaluated = 0;
+    for (int i = 0; i < 25; ++i) LOG_EVERY_N(WARNING, 10) << "call " << i << " " << touch();
+    EXPECT_EQ(evaluated, 3);  // skipped calls don't evaluate their operands
+    std::string out = output();
+    EXPECT_NE(out.find("] call 0 1\n"), std::string::npos);
+    EXPECT_NE(out.find("] [suppressed 9] call 10 2\n"), std::string::npos);
+    EXPECT_NE(out.find("] [suppressed 9] call 20 3\n"), std::string::npos);
+
+    // each call site counts on its own; levels below the threshold are not counted
+    set_level(LogSeverity::INFO);
+    for (int i = 0; i < 5; ++i) {
+        LOG_EVERY_N(DEBUG, 2) << "hidden " << touch();
+        LOG_EVERY_N(INFO, 2) << "site b " << i;
+    }
+    EXPECT_EQ(evaluated, 3);
+    EXPECT_NE(output().find("] [suppressed 1] site b 4\n"), std::string::npos);
+}
+
+TEST_F(SlogTest, FirstNAndEveryT) {
+    for (int i = 0; i < 10; ++i) LOG_FIRST_N(INFO, 3) << "first " << i;
+    EXPECT_NE(output().find("first 2\n"), std::string::npos);
+    EXPECT_EQ(output().find("first 3\n"), std::string::npos);
+
+    auto start = std::chrono::steady_clock::now();
+    int  calls = 0;
+    while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(120)) {
+        LOG_EVERY_T(ERROR, 0.05) << "tick " << calls++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::string out   = output();
+    size_t      lines = 0;
+    for (size_t p = out.find("tick "); p != std::string::npos; p = out.find("tick ", p + 1)) ++lines;
+    EXPECT_GE(lines, 2u);
+    EXPECT_LE(lines, 3u);
+    EXPECT_NE(out.find("] [suppressed "), std::string::npos);
+}
+
+TEST_F(SlogTest, RateLimitedMacrosAreStatements) {
+    int n = 0;
+    // must bind to the right `if` without braces
+    if (n == 1)
+        LOG_EVERY_N(INFO, 1) << "not reached";
+    else
+        LOG_FIRST_N(INFO, 1) << "else branch";
+    EXPECT_NE(output().find("else branch"), std::string::npos);
+    EXPECT_EQ(output().find("not reached"), std::string::npos);
+
+    // concurrent callers share one counter: exactly one line per N calls overall
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+        threads.emplace_back([] {
+            for (int i = 0; i < 1000; ++i) LOG_EVERY_N(INFO, 100) << "mt";
+        });
+    for (auto& th : threads) th.join();
+    std::string out   = output();
+    size_t      lines = 0;
+    for (size_t p = out.find("mt\n"); p != std::string::npos; p = out.find("mt\n", p + 1)) ++lines;
+    EXPECT_EQ(lines, 40u);
+}
+
+namespace {
+
+std::shared_ptr<LogWrapper> make_capture(std::shared_ptr<CaptureSink> sink, LogSeverity level) {
+    LogConfig cfg;
+    cfg.log_level = level;
+    auto lw       = std::make_shared<LogWrapper>(cfg, sink);
+    lw->logger_->set_level(spdlog::level::debug);
+    return lw;
+}
+
+}  // namespace
+
+TEST_F(SlogTest, LevelChangesApplyEverywhereAtOnce) {
+    set_level(LogSeverity::WARNING);
+    EXPECT_EQ(cpptools::slog::GetLogLevel(), LogSeverity::WARNING);
+    EXPECT_FALSE(SLOG_IS_ON(INFO));
+    LOG(INFO) << "quiet";
+    set_level(LogSeverity::DEBUG);
+    LOG(DEBUG) << "loud";
+    EXPECT_EQ(output().find("quiet"), std::string::npos);
+    EXPECT_NE(output().find("loud"), std::string::npos);
+
+    cpptools::slog::SetLogPattern("%l|%v");
+    LOG(INFO) << "patterned";
+    EXPECT_NE(output().find("info|["), std::string::npos);
+}
+
+TEST_F(SlogTest, ReplacedWrapperOutlivesStatementsInProgress) {
+    auto a = std::make_shared<CaptureSink>();
+    auto b = std::make_shared<CaptureSink>();
+    cpptools::slog::SetLogWrapper(make_capture(a, LogSeverity::DEBUG));
+    std::weak_ptr<LogWrapper> first = cpptools::slog::getLogWrapper();
+
+    // the swap happens while the outer statement is being built
+    auto swap = [&] {
+        cpptools::slog::SetLogWrapper(make_capture(b, LogSeverity::DEBUG));
+        LOG(INFO) << "inner";
+        return 1;
+    };
+    LOG(INFO) << "outer " << swap();
+    EXPECT_EQ(a->lines.size(), 2u);  // nested statements stay on the outer one's wrapper
+    EXPECT_TRUE(b->lines.empty());
+    EXPECT_FALSE(first.expired());
+
+    LOG(INFO) << "next";
+    ASSERT_EQ(b->lines.size(), 1u);
+    EXPECT_NE(b->lines[0].text.find("next"), std::string::npos);
+    EXPECT_TRUE(first.expired());
+}
+
+TEST_F(SlogTest, ReconfigureWhileLogging) {
+    std::atomic<bool>        stop{false};
+    std::atomic<long>        logged{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+        threads.emplace_back([&] {
+            while (!stop) {
+                LOG(INFO) << "busy " << logged++;
+                LOGF(DEBUG, "debug {}", 1);
+            }
+        });
+
+    std::vector<std::shared_ptr<CaptureSink>> sinks;
+    for (int i = 0; i < 200; ++i) {
+        sinks.push_back(std::make_shared<CaptureSink>());
+        cpptools::slog::SetLogWrapper(make_capture(sinks.back(), i % 2 ? LogSeverity::DEBUG : LogSeverity::INFO));
+        cpptools::slog::SetLogLevel(i % 3 ? LogSeverity::INFO : LogSeverity::DEBUG);
+        cpptools::slog::SetLogPattern(i % 2 ? "%v" : "%l %v");
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    cpptools::slog::ShutdownLoggingCompat();
+    EXPECT_EQ(cpptools::slog::getLogWrapper(), nullptr);
+    LOG(INFO) << "after shutdown";  // dropped, no crash
+    stop = true;
+    for (auto& th : threads) th.join();
+    EXPECT_GT(logged.load(), 0);
+}
+
+TEST_F(SlogTest, InitCanBeCalledAgain) {
+    std::string path = ::testing::TempDir() + "slog_reinit.log";
+    std::remove(path.c_str());
+    LogConfig cfg;
+    cfg.progname      = "reinit";
+    cfg.log_to_stderr = false;
+    cfg.log_file      = path;
+    cfg.log_level     = LogSeverity::WARNING;
+    cpptools::slog::InitLoggingCompat(cfg);
+    LOG(INFO) << "hidden";
+    LOG(WARNING) << "first config";
+
+    cfg.log_level    = LogSeverity::DEBUG;
+    cfg.file_pattern = "<%l> %v";
+    cpptools::slog::InitLoggingCompat(cfg);
+    LOG(DEBUG) << "second config";
+    EXPECT_NE(spdlog::get("reinit"), nullptr);
+    cpptools::slog::ShutdownLoggingCompat();
+
+    std::ifstream in(path);
+    std::string   text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(text.find("hidden"), std::string::npos);
+    EXPECT_NE(text.find("[warning] [slog_test.cpp:"), std::string::npos);
+    EXPECT_NE(text.find("<debug> [slog_test.cpp:"), std::string::npos);
+}
+
+TEST_F(SlogTest, ShutdownReleasesSinksHeldByIdleThreads) {
+    std::string path = ::testing::TempDir() + "slog_retire.log";
+    std::remove(path.c_str());
+    LogConfig cfg;
+    cfg.progname      = "retire";
+    cfg.log_to_stderr = false;
+    cfg.log_file      = path;
+    cfg.async         = true;
+    cpptools::slog::InitLoggingCompat(cfg);
+    auto dist = std::dynamic_pointer_cast<spdlog::sinks::dist_sink_mt>(spdlog::get("retire")->sinks().at(0));
+    ASSERT_TRUE(dist);
+    std::weak_ptr<spdlog::sinks::sink> file = dist->sinks().at(0);
+    std::weak_ptr<LogWrapper>          wrapper = cpptools::slog::getLogWrapper();
+
+    // a thread that logged once and then sits idle keeps its snapshot of the wrapper
+    std::promise<void> logged, release;
+    std::thread        idle([&] {
+        LOG(INFO) << "before shutdown";
+        logged.set_value();
+        release.get_future().wait();
+        LOG(INFO) << "after shutdown";
+    });
+    logged.get_future().wait();
+    cpptools::slog::ShutdownLoggingCompat();
+
+    EXPECT_FALSE(wrapper.expired());
+    EXPECT_TRUE(file.expired());  // closed now, not when the idle thread lets go
+    EXPECT_NE(read_file(path).find("before shutdown"), std::string::npos);
+
+    release.set_value();
+    idle.join();
+    EXPECT_TRUE(wrapper.expired());
+    EXPECT_EQ(read_file(path).find("after shutdown"), std::string::npos);
+}
+
+TEST_F(SlogTest, StatementsSpanningReinitGoToTheNewLogger) {
+    auto      a = std::make_shared<CaptureSink>();
+    auto      b = std::make_shared<CaptureSink>();
+    LogConfig cfg;
+    cfg.log_level = LogSeverity::DEBUG;
+    cpptools::slog::SetLogWrapper(std::make_shared<LogWrapper>(cfg, a));
+    auto replace = [&] {
+        auto old = cpptools::slog::SetLogWrapper(std::make_shared<LogWrapper>(cfg, b));
+        old->retire();
+        return 1;
+    };
+    LOG(INFO) << "spans " << replace();
+    EXPECT_TRUE(a->lines.empty());
+    ASSERT_EQ(b->lines.size(), 1u);
+    EXPECT_NE(b->lines[0].text.find("spans 1"), std::string::npos);
+}
+
+TEST_F(SlogTest, VModuleOverridesPerFile) {
+    set_level(LogSeverity::INFO);
+    auto debug_here = [] { LOG(DEBUG) << "site debug"; };
+    auto warn_here  = [] { LOG(WARNING) << "site warning"; };
+
+    debug_here();
+    EXPECT_EQ(output().find("site debug"), std::string::npos);
+
+    // the same call sites decide again once the rules change
+    ASSERT_TRUE(cpptools::slog::SetVModule("nothing_*=ERROR,slog_te?t=DEBUG"));
+    debug_here();
+    EXPECT_NE(output().find("debug [slog_test.cpp:"), std::string::npos);
+
+    ASSERT_TRUE(cpptools::slog::SetVModule("tests/slog_*.cpp=ERROR"));
+    warn_here();
+    EXPECT_EQ(output().find("site warning"), std::string::npos);
+
+    ASSERT_TRUE(cpptools::slog::SetVModule(""));
+    warn_here();
+    EXPECT_NE(output().find("site warning"), std::string::npos);
+
+    EXPECT_FALSE(cpptools::slog::SetVModule("slog_test=LOUD"));
+    EXPECT_FALSE(cpptools::slog::SetVModule("=DEBUG"));
+    EXPECT_FALSE(cpptools::slog::SetVModule("slog_test"));
+}
+
+TEST_F(SlogTest, VModuleFromConfig) {
+    auto      cap = std::make_shared<CaptureSink>();
+    LogConfig cfg;
+    cfg.log_level = LogSeverity::ERROR;
+    cfg.vmodule   = "slog_test.cpp=DEBUG";
+    cpptools::slog::SetLogWrapper(std::make_shared<LogWrapper>(cfg, cap));
+    EXPECT_EQ(cpptools::slog::GetLogLevel(), LogSeverity::ERROR);
+    LOG(DEBUG) << "from config";
+    LOGF(INFO, "{} too", "formatted");
+    ASSERT_EQ(cap->lines.size(), 2u);
+    EXPECT_EQ(cap->lines[0].text.rfind("[slog_test.cpp:", 0), 0u);
+
+    // raising the global level leaves the module alone
+    set_level(LogSeverity::FATAL);
+    LOG(DEBUG) << "still here";
+    EXPECT_EQ(cap->lines.size(), 3u);
+}
+
+TEST(SlogVModuleTest, Patterns) {
+    using cpptools::slog::detail::VModuleMatches;
+    EXPECT_TRUE(VModuleMatches("uri", "/src/net/uri.h"));
+    EXPECT_TRUE(VModuleMatches("uri.h", "/src/net/uri.h"));
+    EXPECT_TRUE(VModuleMatches("uri_*", "net/uri_router.h"));
+    EXPECT_FALSE(VModuleMatches("uri", "net/uri_router.h"));
+    EXPECT_TRUE(VModuleMatches("net/*", "/src/net/uri.h"));
+    EXPECT_TRUE(VModuleMatches("/src/*/uri.h", "/src/net/uri.h"));
+    EXPECT_FALSE(VModuleMatches("et/*", "/src/net/uri.h"));
+    EXPECT_TRUE(VModuleMatches("*", "main.cpp"));
+    static_assert(std::string_view(cpptools::slog::detail::Basename("a/b/c.cpp")) == "c.cpp");
+    static_assert(std::string_view(cpptools::slog::detail::Basename("c.cpp")) == "c.cpp");
+}
+
+namespace {
+
+std::string mmap_test_path(const char* name) {
+    std::string path = ::testing::TempDir() + name;
+    for (size_t i = 0; i <= 10; ++i)
+        std::remove(spdlog::sinks::rotating_file_sink_mt::calc_filename(path, i).c_str());
+    return path;
+}
+
+}  // namespace
+
+TEST(SlogMmapSinkTest, TruncatesToWhatWasWritten) {
+    std::string path = mmap_test_path("slog_mmap_basic.log");
+    {
+        auto sink = std::make_shared<cpptools::slog::MmapFileSink>(path, 1 << 20, 2);
+        sink->set_pattern("%v");
+        spdlog::logger lg("mmap", sink);
+        lg.info("hello");
+        lg.info("world {}", 42);
+        lg.flush();
+    }
+    EXPECT_EQ(read_file(path), "hello\nworld 42\n");
+    EXPECT_FALSE(spdlog::details::os::path_exists(path + ".next"));
+
+    // an existing file is rotated out, not appended to
+    {
+        auto sink = std::make_shared<cpptools::slog::MmapFileSink>(path, 1 << 20, 2);
+        sink->set_pattern("%v");
+        spdlog::logger("mmap", sink).info("again");
+    }
+    EXPECT_EQ(read_file(path), "again\n");
+    EXPECT_EQ(read_file(spdlog::sinks::rotating_file_sink_mt::calc_filename(path, 1)), "hello\nworld 42\n");
+}
+
+TEST(SlogMmapSinkTest, RotatesAndKeepsMaxFiles) {
+    using spdlog::sinks::rotating_file_sink_mt;
+    std::string path = mmap_test_path("slog_mmap_rotate.log");
+    auto        sink = std::make_shared<cpptools::slog::MmapFileSink>(path, 4096, 2);
+    sink->set_pattern("%v");
+    ASSERT_EQ(sink->segment_size(), 4096u);
+    {
+        spdlog::logger lg("mmap", sink);
+        // 100-byte lines, 40 to a 4096-byte file: the fifth segment is live when we stop
+        for (int i = 0; i < 40 * 4 + 5; ++i) lg.info("{:03} {}", i, std::string(95, 'x'));
+    }
+    sink.reset();
+
+    // two rotated files plus the live one, each holding whole lines; everything older was dropped
+    EXPECT_FALSE(spdlog::details::os::path_exists(rotating_file_sink_mt::calc_filename(path, 3)));
+    int first[] = {160, 120, 80}, count[] = {5, 40, 40};
+    for (size_t f = 0; f <= 2; ++f) {
+        std::istringstream in(read_file(rotating_file_sink_mt::calc_filename(path, f)));
+        std::string        line;
+        int                n = 0;
+        while (std::getline(in, line)) {
+            ASSERT_EQ(line.size(), 99u) << f;
+            EXPECT_EQ(std::stoi(line.substr(0, 3)), first[f] + n) << f;
+            ++n;
+        }
+        EXPECT_EQ(n, count[f]) << f;
+    }
+}
+
+TEST(SlogMmapSinkTest, OnlyLinesLongerThanASegmentSpanFiles) {
+    using spdlog::sinks::rotating_file_sink_mt;
+    std::string path = mmap_test_path("slog_mmap_long.log");
+    {
+        auto sink = std::make_shared<cpptools::slog::MmapFileSink>(path, 4096, 3);
+        sink->set_pattern("%v");
+        spdlog::logger lg("mmap", sink);
+        lg.info("short");
+        lg.info(std::string(6000, 'L'));
+        lg.info("after");
+    }
+    // the long line fills what is left of the segment and runs into the next one
+    EXPECT_FALSE(spdlog::details::os::path_exists(rotating_file_sink_mt::calc_filename(path, 2)));
+    EXPECT_EQ(read_file(rotating_file_sink_mt::calc_filename(path, 1)), "short\n" + std::string(4090, 'L'));
+    EXPECT_EQ(read_file(path), std::string(6000 - 4090, 'L') + "\nafter\n");
+}
+
+TEST(SlogMmapSinkTest, ConcurrentWritersKeepLinesIntact) {
+    std::string path = mmap_test_path("slog_mmap_threads.log");
+    {
+        auto sink = std::make_shared<cpptools::slog::MmapFileSink>(path, 64 << 10, 4);
+        sink->set_pattern("%v");
+        spdlog::logger           lg("mmap", sink);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t)
+            threads.emplace_back([&lg, t] {
+                for (int i = 0; i < 2000; ++i) lg.info("thread {} line {:04}", t, i);
+            });
+        for (auto& th : threads) th.join();
+    }
+    std::string all;
+    for (size_t i = 4; i != size_t(-1); --i)
+        all += read_file(spdlog::sinks::rotating_file_sink_mt::calc_filename(path, i));
+    // 4 x 2000 lines of 19 bytes is ~150KB: two rotations, nothing dropped
+    std::istringstream in(all);
+    std::string        line;
+    int                n = 0;
+    while (std::getline(in, line)) {
+        ASSERT_EQ(line.size(), 18u) << line;
+        ASSERT_EQ(line.rfind("thread ", 0), 0u) << line;
+        ++n;
+    }
+    EXPECT_EQ(n, 8000);
+}
+
+TEST_F(SlogTest, InitWithMmapSink) {
+    std::string path = mmap_test_path("slog_mmap_init.log");
+    LogConfig   cfg;
+    cfg.progname      = "mmapinit";
+    cfg.log_to_stderr = false;
+    cfg.log_file      = path;
+    cfg.log_file_mmap = true;
+    cpptools::slog::InitLoggingCompat(cfg);
+    LOG(WARNING) << "mapped " << 7;
+    cpptools::slog::ShutdownLoggingCompat();
+    EXPECT_NE(read_file(path).find("[warning] [slog_test.cpp:"), std::string::npos);
+}
+
+TEST_F(SlogTest, ReinitWithMmapSinkKeepsBothLoggersIntact) {
+    using spdlog::sinks::rotating_file_sink_mt;
+    std::string path = mmap_test_path("slog_mmap_reinit.log");
+    LogConfig   cfg;
+    cfg.progname      = "mmapreinit";
+    cfg.log_to_stderr = false;
+    cfg.log_file      = path;
+    cfg.log_file_mmap = true;
+    cfg.max_file_size = 4096;
+    cfg.max_files     = 10;
+    cfg.file_pattern  = "%v";
+    for (int round = 0; round < 3; ++round) {
+        cpptools::slog::InitLoggingCompat(cfg);
+        for (int i = 0; i < 200; ++i) LOGF(INFO, "round {} line {:03}", round, i);
+    }
+    cpptools::slog::ShutdownLoggingCompat();
+
+    // every file holds whole lines; the newest round is in the live file
+    std::string all;
+    for (size_t i = 10; i != size_t(-1); --i) all += read_file(rotating_file_sink_mt::calc_filename(path, i));
+    std::istringstream in(all);
+    std::string        line;
+    int                n = 0;
+    while (std::getline(in, line)) {
+        ASSERT_NE(line.find("] round "), std::string::npos) << line;
+        ++n;
+    }
+    EXPECT_EQ(n, 600);
+    EXPECT_NE(read_file(path).find("round 2 line 199\n"), std::string::npos);
+}
+
+TEST(SlogMmapSinkTest, ReportsAndRecoversWhenSegmentsCannotBeCreated) {
+    std::string dir  = ::testing::TempDir() + "slog_mmap_fail/";
+    std::string path = dir + "app.log";
+    std::remove(path.c_str());
+    auto        sink = std::make_shared<cpptools::slog::MmapFileSink>(path, 4096, 2);
+    sink->set_pattern("%v");
+    spdlog::logger lg("mmap", sink);
+    int            errors = 0;
+    lg.set_error_handler([&errors](const std::string&) { ++errors; });
+    lg.info("before");
+
+    // with the directory gone no segment can be created or named; writing carries on
+    std::remove(path.c_str());
+    ASSERT_EQ(::rmdir(dir.c_str()), 0);
+    for (int i = 0; i < 200; ++i) lg.info("lost {:03} {}", i, std::string(90, 'x'));
+    EXPECT_GE(errors, 1);
+    EXPECT_LE(errors, 2);  // once per failure, not per line
+
+    // the worker retries every second
+    spdlog::details::os::create_dir(dir);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+    lg.info("recovered");
+    lg.flush();
+    lg.sinks().clear();
+    sink.reset();
+    EXPECT_EQ(read_file(path), "recovered\n");
+}
+
+#ifdef SLOG_WITH_ZLIB
+namespace {
+
+std::string gunzip_file(const std::string& path) {
+    std::string out;
+    gzFile      in = gzopen(path.c_str(), "rb");
+    if (!in) return out;
+    char buf[4096];
+    for (int n; (n = gzread(in, buf, sizeof buf)) > 0;) out.append(buf, size_t(n));
+    gzclose(in);
+    return out;
+}
+
+}  // namespace
+
+TEST(SlogArchiverTest, RotatedFilesAreCompressedAndCounted) {
+    std::string path = mmap_test_path("slog_archive.log");
+    auto        sink = std::make_shared<cpptools::slog::ArchivingFileSink>(path, 1000, 3,
+                                                                           cpptools::slog::LogCompression::GZIP);
+    sink->set_pattern("%v");
+    spdlog::logger lg("archive", sink);
+    // 10 bytes a line, 100 lines a file; files 0..5 fill up, file 6 is live
+    for (int f = 0; f < 7; ++f)
+        for (int i = 0; i < 100; ++i) lg.info("file {} {:02}", f, i);
+    lg.flush();
+    sink->archiver().wait_idle();
+
+    EXPECT_EQ(read_file(path).rfind("file 6 00\n", 0), 0u);
+    auto& ar = sink->archiver();
+    EXPECT_EQ(ar.archive_name(1), spdlog::sinks::rotating_file_sink_mt::calc_filename(path, 1) + ".gz");
+    for (size_t i = 1; i <= 3; ++i) {
+        std::string text = gunzip_file(ar.archive_name(i));
+        ASSERT_EQ(text.size(), 1000u) << i;
+        EXPECT_EQ(text.rfind("file " + std::to_string(6 - i) + " 00\n", 0), 0u) << i;
+    }
+    EXPECT_FALSE(spdlog::details::os::path_exists(ar.archive_name(4)));
+    EXPECT_FALSE(spdlog::details::os::path_exists(spdlog::sinks::rotating_file_sink_mt::calc_filename(path, 1)));
+}
+
+TEST(SlogArchiverTest, LeftoverPendingFilesAreRequeuedAndCounted) {
+    std::string path = mmap_test_path("slog_archive_pending.log");
+    auto pending = [&](int seq) { return path + "." + std::to_string(seq) + ".pending"; };
+    {
+        // left by an earlier run; the oldest goes to retention, the other two get compressed
+        for (int seq : {11, 12, 13}) std::ofstream(pending(seq)) << "pending " << seq << "\n";
+        cpptools::slog::LogArchiver ar(path, 2, cpptools::slog::LogCompression::GZIP);
+        ar.wait_idle();
+        EXPECT_EQ(gunzip_file(ar.archive_name(1)), "pending 13\n");
+        EXPECT_EQ(gunzip_file(ar.archive_name(2)), "pending 12\n");
+        EXPECT_FALSE(spdlog::details::os::path_exists(pending(11)));
+        EXPECT_FALSE(spdlog::details::os::path_exists(pending(12)));
+    }
+    for (size_t i = 1; i <= 2; ++i)
+        std::remove((spdlog::sinks::rotating_file_sink_mt::calc_filename(path, i) + ".gz").c_str());
+
+    // files that cannot be compressed (a directory is in the way of the .gz) stay, and count
+    for (int seq : {20, 21}) {
+        std::ofstream(pending(seq)) << "pending " << seq << "\n";
+        ::mkdir((pending(seq) + ".gz").c_str(), 0755);
+    }
+    {
+        cpptools::slog::LogArchiver ar(path, 2, cpptools::slog::LogCompression::GZIP);
+        ar.wait_idle();
+        EXPECT_TRUE(spdlog::details::os::path_exists(pending(20)));
+        EXPECT_TRUE(spdlog::details::os::path_exists(pending(21)));
+
+        std::ofstream(path) << "fresh\n";
+        ar.submit(path);
+        ar.wait_idle();
+        EXPECT_EQ(gunzip_file(ar.archive_name(1)), "fresh\n");
+        EXPECT_FALSE(spdlog::details::os::path_exists(pending(20)));
+        EXPECT_TRUE(spdlog::details::os::path_exists(pending(21)));
+    }
+    for (int seq : {20, 21}) {
+        std::remove(pending(seq).c_str());
+        ::rmdir((pending(seq) + ".gz").c_str());
+    }
+}
+
+TEST(SlogArchiverTest, MmapSinkHandsOffRetiredSegments) {
+    std::string path = mmap_test_path("slog_archive_mmap.log");
+    {
+        auto sink = std::make_shared<cpptools::slog::MmapFileSink>(path, 4096, 2, cpptools::slog::LogCompression::GZIP);
+        sink->set_pattern("%v");
+        spdlog::logger lg("archive", sink);
+        std::string    line(99, 'y');
+        for (int i = 0; i < 40 * 3 + 3; ++i) lg.info(line);
+    }
+    // the sink finishes its archiver's queue on destruction; segments 0..2 hold 40 lines each
+    EXPECT_EQ(gunzip_file(spdlog::sinks::rotating_file_sink_mt::calc_filename(path, 2) + ".gz").size(), 4000u);
+    EXPECT_EQ(gunzip_file(spdlog::sinks::rotating_file_sink_mt::calc_filename(path, 1) + ".gz").size(), 4000u);
+    EXPECT_EQ(read_file(path).size(), 300u);
+}
+#endif
+
+TEST(SlogArchiverTest, UnavailableCodecThrows) {
+#ifndef SLOG_WITH_ZSTD
+    EXPECT_THROW(cpptools::slog::LogArchiver(::testing::TempDir() + "slog_nozstd.log", 2,
+                                             cpptools::slog::LogCompression::ZSTD),
+                 spdlog::spdlog_ex);
+#endif
+#ifndef SLOG_WITH_ZLIB
+    EXPECT_THROW(cpptools::slog::LogArchiver(::testing::TempDir() + "slog_nozlib.log", 2,
+                                             cpptools::slog::LogCompression::GZIP),
+                 spdlog::spdlog_ex);
+#endif
+}
@@ -0,0 +1,75 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "uri_batch.h"
+
+using cpptools::net::BatchOptions;
+using cpptools::net::URIBatch;
+
+TEST(UriBatchTest, Columns) {
+    std::vector<std::string_view> in = {
+        "http://Example.com/a?x=1#f",
+        "bogus",
+        "redis://h1:1,%65xample.com:2/0",
+        "mailto:someone@example.com",
+    };
+    auto b = URIBatch::parse(in);
+    ASSERT_EQ(b.size(), 4);
+    EXPECT_EQ(b.error_count(), 1);
+
+    EXPECT_TRUE(b.ok(0));
+    EXPECT_EQ(b.input(0), in[0]);
+    EXPECT_NE(b.input(0).data(), in[0].data());  // copied into the arena
+    EXPECT_EQ(b.scheme(0), "http");
+    EXPECT_EQ(b.raw_path(0), "/a");
+    EXPECT_EQ(b.raw_query(0).value(), "x=1");
+    EXPECT_EQ(b.fragment(0).value(), "f");
+
+    EXPECT_FALSE(b.ok(1));
+    EXPECT_EQ(b.error(1).code, cpptools::net::uri_errc::missing_scheme);
+    EXPECT_TRUE(b.hosts(1).empty());
+
+    // hosts are decoded, lowercased and shared between rows
+    ASSERT_EQ(b.hosts(0).size(), 1);
+    ASSERT_EQ(b.hosts(2).size(), 2);
+    EXPECT_EQ(b.host_table_size(), 2);
+    EXPECT_EQ(b.host_name(b.hosts(0)[0].id), "example.com");
+    EXPECT_EQ(b.hosts(2)[1].id, b.hosts(0)[0].id);
+    EXPECT_EQ(b.host_name(b.hosts(2)[0].id), "h1");
+    EXPECT_EQ(b.hosts(2)[0].port, 1);
+    EXPECT_FALSE(b.hosts(0)[0].port.has_value());
+
+    EXPECT_TRUE(b.hosts(3).empty());
+    EXPECT_EQ(b.view(3).raw_path(), "someone@example.com");
+    EXPECT_EQ(b.view(2).hosts().size(), 2);
+}
+
+TEST(UriBatchTest, ParallelMatchesSequential) {
+    std::vector<std::string> lines;
+    for (int i = 0; i < 5000; ++i) {
+        if (i % 97 == 0)
+            lines.push_back("http://host" + std::to_string(i % 13) + ":99999/");
+        else
+            lines.push_back("http://user@host" + std::to_string(i % 13) + ":" + std::to_string(i) + "/p/" +
+                            std::to_string(i) + "?q=" + std::to_string(i));
+    }
+    std::vector<std::string_view> in(lines.begin(), lines.end());
+
+    auto seq = URIBatch::parse(in);
+    auto par = URIBatch::parse(in, BatchOptions{.threads = 4, .chunk_rows = 64});
+    ASSERT_EQ(seq.size(), par.size());
+    EXPECT_EQ(seq.error_count(), 52);
+    EXPECT_EQ(par.error_count(), seq.error_count());
+    EXPECT_EQ(par.host_table_size(), 13);
+    for (size_t r = 0; r < in.size(); ++r) {
+        ASSERT_EQ(par.error(r), seq.error(r));
+        EXPECT_EQ(par.raw_path(r), seq.raw_path(r));
+        EXPECT_EQ(par.raw_query(r), seq.raw_query(r));
+        ASSERT_EQ(par.hosts(r).size(), seq.hosts(r).size());
+        for (size_t k = 0; k < par.hosts(r).size(); ++k) {
+            EXPECT_EQ(par.host_name(par.hosts(r)[k].id), seq.host_name(seq.hosts(r)[k].id));
+            EXPECT_EQ(par.hosts(r)[k].port, seq.hosts(r)[k].port);
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "uri_cache.h"
+
+using cpptools::net::URICache;
+using cpptools::net::URICacheOptions;
+
+TEST(UriCacheTest, HitsShareOneParse) {
+    URICache cache;
+    std::string in = "mongodb://a:1,b:2/db?w=1";
+    auto        p1 = cache.get(in);
+    auto        p2 = cache.get(std::string(in));
+    EXPECT_EQ(p1.get(), p2.get());
+    EXPECT_EQ(p1->hosts().size(), 2);
+
+    auto st = cache.stats();
+    EXPECT_EQ(st.hits, 1);
+    EXPECT_EQ(st.misses, 1);
+    EXPECT_EQ(st.entries, 1);
+    EXPECT_GT(st.bytes, in.size());
+}
+
+TEST(UriCacheTest, FailuresAreNotCached) {
+    URICache cache;
+    auto     r = cache.try_get("http://h:99999");
+    ASSERT_FALSE(r.has_value());
+    EXPECT_EQ(r.error().code, cpptools::net::uri_errc::port_out_of_range);
+    EXPECT_THROW(cache.get("http://h:99999"), cpptools::net::parse_error);
+    auto st = cache.stats();
+    EXPECT_EQ(st.failures, 2);
+    EXPECT_EQ(st.entries, 0);
+}
+
+TEST(UriCacheTest, LruEviction) {
+    URICache cache(URICacheOptions{.max_entries = 2, .shards = 1});
+    auto     a = cache.get("http://a/");
+    cache.get("http://b/");
+    cache.get("http://a/");  // a becomes most recent
+    cache.get("http://c/");  // evicts b
+    EXPECT_EQ(cache.stats().evictions, 1);
+    EXPECT_EQ(cache.get("http://a/").get(), a.get());
+    auto before = cache.stats().misses;
+    cache.get("http://b/");
+    EXPECT_EQ(cache.stats().misses, before + 1);
+    // evicted entries stay alive while referenced
+    EXPECT_EQ(a->to_string(), "http://a/");
+}
+
+TEST(UriCacheTest, ByteBudget) {
+    URICache cache(URICacheOptions{.max_entries = 1000, .max_bytes = 4096, .shards = 2});
+    for (int i = 0; i < 200; ++i) cache.get("http://host" + std::to_string(i) + "/" + std::string(100, 'p'));
+    auto st = cache.stats();
+    EXPECT_LE(st.bytes, 4096);
+    EXPECT_LT(st.entries, 200);
+    EXPECT_GT(st.evictions, 0);
+}
+
+TEST(UriCacheTest, FewerEntriesThanShards) {
+    URICache cache(URICacheOptions{.max_entries = 3, .shards = 16});
+    for (int i = 0; i < 50; ++i) cache.get("http://h" + std::to_string(i) + "/");
+    auto st = cache.stats();
+    EXPECT_EQ(st.entries, 3);
+    EXPECT_EQ(st.evictions, 47);
+}
+
+TEST(UriCacheTest, Concurrent) {
+    URICache                 cache(URICacheOptions{.max_entries = 64, .shards = 4});
+    std::vector<std::thread> ts;
+    for (int t = 0; t < 4; ++t)
+        ts.emplace_back([&cache, t] {
+            for (int i = 0; i < 2000; ++i) {
+                auto u = cache.get("http://h" + std::to_string((i * 7 + t) % 100) + ":80/x");
+                ASSERT_EQ(u->hosts().size(), 1);
+            }
+        });
+    for (auto& t : ts) t.join();
+    auto st = cache.stats();
+    EXPECT_EQ(st.hits + st.misses, 8000);
+    EXPECT_LE(st.entries, 64);
+}
@@ -0,0 +1,98 @@
+#include <chrono>
+#include <optional>
+#include <string>
+
+#include <gtest/gtest.h>
+#include "uri_options.h"
+
+using namespace std::chrono_literals;
+using cpptools::net::make_option_schema;
+using cpptools::net::option;
+using cpptools::net::option_errc;
+using cpptools::net::OptionError;
+using cpptools::net::size_option;
+using cpptools::net::URI;
+
+namespace {
+
+struct MongoOptions {
+    std::chrono::milliseconds  timeout{30000};
+    std::chrono::seconds       heartbeat{10};
+    int                        maxPoolSize = 100;
+    uint16_t                   minPoolSize = 0;
+    std::string                replicaSet;
+    std::optional<std::string> authSource;
+    bool                       tls = false;
+    std::optional<bool>        retryWrites;
+    double                     ratio      = 0;
+    size_t                     bufferSize = 0;
+    std::optional<uint64_t>    maxMessage;
+};
+
+constexpr auto kSchema = make_option_schema<MongoOptions>(
+    option("timeout", &MongoOptions::timeout, 5s), option("heartbeat", &MongoOptions::heartbeat),
+    option("maxPoolSize", &MongoOptions::maxPoolSize), option("minPoolSize", &MongoOptions::minPoolSize),
+    option("replicaSet", &MongoOptions::replicaSet, "rs-default"), option("authSource", &MongoOptions::authSource),
+    option("tls", &MongoOptions::tls), option("retryWrites", &MongoOptions::retryWrites),
+    option("ratio", &MongoOptions::ratio), size_option("bufferSize", &MongoOptions::bufferSize, 64 * 1024),
+    size_option("maxMessage", &MongoOptions::maxMessage));
+static_assert(kSchema.size() == 11);
+
+}  // namespace
+
+TEST(UriOptionsTest, DecodesTypedValues) {
+    URI  u("mongodb://a:1,b:2/db?timeout=1.5s&maxPoolSize=200&replicaSet=rs%200&tls&retryWrites=No"
+           "&ratio=0.25&bufferSize=4KiB&maxMessage=16MB&heartbeat=250&authSource=admin");
+    auto r = kSchema.decode(u);
+    EXPECT_TRUE(r.ok());
+    EXPECT_EQ(r.value.timeout, 1500ms);
+    EXPECT_EQ(r.value.heartbeat, 250s);  // bare numbers count in the member's unit
+    EXPECT_EQ(r.value.maxPoolSize, 200);
+    EXPECT_EQ(r.value.replicaSet, "rs 0");
+    EXPECT_EQ(r.value.authSource, "admin");
+    EXPECT_TRUE(r.value.tls);
+    EXPECT_EQ(r.value.retryWrites, false);
+    EXPECT_DOUBLE_EQ(r.value.ratio, 0.25);
+    EXPECT_EQ(r.value.bufferSize, 4096u);
+    EXPECT_EQ(r.value.maxMessage, 16000000u);
+
+    // defaults come from the schema, then from the struct
+    auto d = kSchema.decode(URI("mongodb://h/db"));
+    EXPECT_TRUE(d.ok());
+    EXPECT_EQ(d.value.timeout, 5s);
+    EXPECT_EQ(d.value.replicaSet, "rs-default");
+    EXPECT_EQ(d.value.bufferSize, 64u * 1024);
+    EXPECT_EQ(d.value.maxPoolSize, 100);
+    EXPECT_FALSE(d.value.retryWrites);
+
+    EXPECT_EQ(kSchema.decode(URI("x://h/?timeout=2m")).value.timeout, 120s);
+    EXPECT_EQ(kSchema.decode(URI("x://h/?timeout=250us")).value.timeout, 0ms);
+    EXPECT_EQ(kSchema.decode(URI("x://h/?bufferSize=1.5k")).value.bufferSize, 1536u);
+    EXPECT_EQ(kSchema.decode(URI("x://h/?bufferSize=2G")).value.bufferSize, 2ull << 30);
+
+    // values longer than the stack buffer are still parsed, not rejected
+    auto padded = kSchema.decode(URI("x://h/?maxPoolSize=" + std::string(100, '0') + "42&ratio=0." +
+                                     std::string(80, '5')));
+    EXPECT_TRUE(padded.ok());
+    EXPECT_EQ(padded.value.maxPoolSize, 42);
+    EXPECT_NEAR(padded.value.ratio, 0.5555, 1e-3);
+}
+
+TEST(UriOptionsTest, ReportsErrorsWithoutThrowing) {
+    URI  u("mongodb://h/db?maxPoolSize=12x&bogus=1&minPoolSize=70000&timeout=3 parsecs&replicaSet&tls=maybe"
+           "&bufferSize=-1&timeout=9s&maxPoolSize=7");
+    auto r = kSchema.decode(u);
+    ASSERT_EQ(r.errors.size(), 7u);
+    EXPECT_EQ(r.errors[0], (OptionError{option_errc::invalid_value, "maxPoolSize", "12x"}));
+    EXPECT_EQ(r.errors[1], (OptionError{option_errc::unknown_option, "bogus", "1"}));
+    EXPECT_EQ(r.errors[2].code, option_errc::out_of_range);
+    EXPECT_EQ(r.errors[3].code, option_errc::bad_unit);
+    EXPECT_EQ(r.errors[4].code, option_errc::missing_value);
+    EXPECT_EQ(r.errors[5].code, option_errc::invalid_value);
+    EXPECT_EQ(r.errors[6].code, option_errc::out_of_range);
+    EXPECT_STREQ(r.errors[0].message(), "invalid value");
+    // good values still land, later ones win
+    EXPECT_EQ(r.value.timeout, 9s);
+    EXPECT_EQ(r.value.maxPoolSize, 7);
+    EXPECT_EQ(r.value.minPoolSize, 0);
+}
@@ -0,0 +1,152 @@
+#include <arpa/inet.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "uri_resolver.h"
+
+using namespace std::chrono_literals;
+using cpptools::net::HostResolver;
+using cpptools::net::ResolverOptions;
+using cpptools::net::SockAddr;
+using cpptools::net::URI;
+
+namespace {
+
+// answers "good*" names with 192.0.2.<n>, everything else with EAI_NONAME
+ResolverOptions fake(std::atomic<int>& calls, std::chrono::milliseconds delay = 0ms) {
+    ResolverOptions o;
+    o.lookup = [&calls, delay](const std::string& name, int, std::vector<SockAddr>& out) {
+        ++calls;
+        std::this_thread::sleep_for(delay);
+        if (name.rfind("good", 0) != 0) return EAI_NONAME;
+        SockAddr sa;
+        auto*    in         = reinterpret_cast<sockaddr_in*>(&sa.storage);
+        in->sin_family      = AF_INET;
+        in->sin_addr.s_addr = htonl(0xC0000200 | uint32_t(name.size()));
+        sa.len              = sizeof(sockaddr_in);
+        out.push_back(sa);
+        return 0;
+    };
+    return o;
+}
+
+uint16_t port_of(const SockAddr& sa) { return ntohs(reinterpret_cast<const sockaddr_in*>(sa.addr())->sin_port); }
+
+}  // namespace
+
+TEST(UriResolverTest, ResolvesWholeHostListInOrder) {
+    std::atomic<int> calls{0};
+    HostResolver     r(fake(calls, 20ms));
+    auto             res = r.resolve(URI("etcd://good1:2379,bad:2380,[::1]:2381,10.0.0.1,good22"), 4000);
+    ASSERT_EQ(res.size(), 5u);
+    ASSERT_TRUE(res[0].ok());
+    EXPECT_EQ(port_of(res[0].addrs[0]), 2379);
+    EXPECT_FALSE(res[1].ok());
+    EXPECT_EQ(res[1].error, EAI_NONAME);
+    EXPECT_STRNE(res[1].message(), "ok");
+    // IP literals never reach the lookup
+    ASSERT_TRUE(res[2].ok());
+    EXPECT_EQ(res[2].addrs[0].family(), AF_INET6);
+    EXPECT_EQ(ntohs(reinterpret_cast<const sockaddr_in6*>(res[2].addrs[0].addr())->sin6_port), 2381);
+    ASSERT_TRUE(res[3].ok());
+    EXPECT_EQ(port_of(res[3].addrs[0]), 4000);
+    EXPECT_EQ(res[4].host.host, "good22");
+    EXPECT_EQ(calls, 3);
+
+    // well-known scheme port when neither the host nor the caller gives one
+    EXPECT_EQ(port_of(r.resolve(URI("https://good1/"))[0].addrs[0]), 443);
+}
+
+TEST(UriResolverTest, CachesWithTtlAndNegativeTtl) {
+    std::atomic<int> calls{0};
+    auto             opts = fake(calls);
+    opts.ttl              = 200ms;
+    opts.negative_ttl     = 50ms;
+    HostResolver r(opts);
+
+    URI u("x://good,bad");
+    r.resolve(u);
+    r.resolve(u);
+    EXPECT_EQ(calls, 2);
+    EXPECT_EQ(r.stats().hits, 2u);
+    EXPECT_EQ(r.stats().entries, 2u);
+
+    std::this_thread::sleep_for(80ms);  // only the failure has expired
+    r.resolve(u);
+    EXPECT_EQ(calls, 3);
+    std::this_thread::sleep_for(250ms);
+    r.resolve(u);
+    EXPECT_EQ(calls, 5);
+
+    r.clear();
+    EXPECT_EQ(r.stats().entries, 0u);
+}
+
+TEST(UriResolverTest, ZeroMaxEntriesDisablesCache) {
+    std::atomic<int> calls{0};
+    auto             opts = fake(calls);
+    opts.max_entries      = 0;
+    HostResolver r(opts);
+
+    URI u("x://good,bad");
+    EXPECT_TRUE(r.resolve(u)[0].ok());
+    EXPECT_TRUE(r.resolve(u)[0].ok());
+    EXPECT_EQ(calls, 4);
+    EXPECT_EQ(r.stats().hits, 0u);
+    EXPECT_EQ(r.stats().entries, 0u);
+}
+
+TEST(UriResolverTest, CoalescesConcurrentLookups) {
+    std::atomic<int> calls{0};
+    HostResolver     r(fake(calls, 100ms));
+    URI              u("x://good:1,good:2");
+
+    std::vector<std::thread> ts;
+    std::atomic<int>         ok{0};
+    for (int t = 0; t < 8; ++t) ts.emplace_back([&] { ok += r.resolve(u)[1].ok(); });
+    for (auto& t : ts) t.join();
+    EXPECT_EQ(ok, 8);
+    EXPECT_EQ(calls, 1);
+    EXPECT_GT(r.stats().coalesced, 0u);
+}
+
+TEST(UriResolverTest, ThrowingLookupIsANegativeResult) {
+    std::atomic<int> calls{0};
+    ResolverOptions  opts;
+    opts.negative_ttl = 50ms;
+    opts.lookup       = [&calls](const std::string&, int, std::vector<SockAddr>&) -> int {
+        if (++calls == 1) throw std::runtime_error("resolver backend down");
+        return EAI_NONAME;
+    };
+    HostResolver r(opts);
+    URI          u("x://flaky:1");
+
+    auto res = r.resolve(u);
+    ASSERT_EQ(res.size(), 1u);
+    EXPECT_EQ(res[0].error, EAI_FAIL);
+    EXPECT_EQ(r.resolve(u)[0].error, EAI_FAIL);  // cached like any failure
+    EXPECT_EQ(calls, 1);
+
+    // once negative_ttl passes the name is looked up again
+    std::this_thread::sleep_for(80ms);
+    EXPECT_EQ(r.resolve(u)[0].error, EAI_NONAME);
+    EXPECT_EQ(calls, 2);
+}
+
+TEST(UriResolverTest, SystemLookupOfLocalhost) {
+    HostResolver r;
+    auto         res = r.resolve(URI("mongodb://localhost:27017,localhost:27018/db"));
+    ASSERT_EQ(res.size(), 2u);
+    ASSERT_TRUE(res[0].ok()) << res[0].message();
+    for (const auto& sa : res[1].addrs) {
+        ASSERT_TRUE(sa.family() == AF_INET || sa.family() == AF_INET6);
+        EXPECT_EQ(ntohs(reinterpret_cast<const sockaddr_in*>(sa.addr())->sin_port), 27018);  // same offset in both
+    }
+    EXPECT_EQ(r.stats().lookups, 1u);
+}
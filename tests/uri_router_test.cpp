@@ -0,0 +1,117 @@
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "uri_router.h"
+
+using cpptools::net::PathRouter;
+
+namespace {
+
+PathRouter<int> sample() {
+    PathRouter<int>::Builder b;
+    b.add("/", 0)
+        .add("/v1/users", 1)
+        .add("/v1/users/", 2)
+        .add("/v1/users/{id}", 3)
+        .add("/v1/users/{id}/orders", 4)
+        .add("/v1/users/me/orders", 5)
+        .add("/v1/users/{id}/orders/{order}", 6)
+        .add("/static/{*file}", 7)
+        .add("/v1/a/b/c/d", 8)
+        .add("/v1/a/b/x", 9);
+    return std::move(b).build();
+}
+
+}  // namespace
+
+TEST(UriRouterTest, Matching) {
+    auto r = sample();
+    EXPECT_EQ(r.size(), 10);
+    auto at = [&](std::string_view p) { auto m = r.match(p); return m ? *m.value : -1; };
+
+    EXPECT_EQ(at("/"), 0);
+    EXPECT_EQ(at(""), 0);
+    EXPECT_EQ(at("/v1/users"), 1);
+    EXPECT_EQ(at("/v1/users/"), 2);
+    EXPECT_EQ(at("/v1/users/42"), 3);
+    EXPECT_EQ(at("/v1/users/42/orders"), 4);
+    EXPECT_EQ(at("/v1/users/me/orders"), 5);
+    EXPECT_EQ(at("/v1/users/42/orders/7"), 6);
+    EXPECT_EQ(at("/v1/a/b/c/d"), 8);
+    EXPECT_EQ(at("/v1/a/b/x"), 9);
+    EXPECT_EQ(at("/v1/a/b/c"), -1);
+    EXPECT_EQ(at("/v1/a/b/c/d/e"), -1);
+    EXPECT_EQ(at("/v1/users/42/orders/"), -1);
+    EXPECT_EQ(at("/v2"), -1);
+    EXPECT_EQ(at("relative"), -1);
+
+    // static wins, but a dead end falls back to the parameter
+    auto m = r.match("/v1/users/me/orders/9");
+    ASSERT_TRUE(m);
+    EXPECT_EQ(*m.value, 6);
+    EXPECT_EQ(m.pattern, "/v1/users/{id}/orders/{order}");
+    EXPECT_EQ(m.param("id"), "me");
+    EXPECT_EQ(m.param("order"), "9");
+    EXPECT_FALSE(m.param("nope"));
+
+    // captures are raw views into the path
+    std::string path = "/static/css/a%20b.css";
+    m = r.match(path);
+    ASSERT_TRUE(m);
+    EXPECT_EQ(*m.value, 7);
+    EXPECT_EQ(m.param("file"), "css/a%20b.css");
+    EXPECT_EQ(m.params[0].value.data(), path.data() + 8);
+    EXPECT_EQ(cpptools::net::URI::percent_decode(*m.param("file")), "css/a b.css");
+    EXPECT_EQ(r.match("/static/").param("file"), "");
+
+    cpptools::net::URI u("http://h/v1/users/%41?x=1");
+    EXPECT_EQ(r.match(u).param("id"), "%41");
+}
+
+TEST(UriRouterTest, BadPatterns) {
+    PathRouter<int>::Builder b;
+    b.add("/a/{id}", 1);
+    EXPECT_THROW(b.add("a", 0), std::invalid_argument);
+    EXPECT_THROW(b.add("/a/{id}", 2), std::invalid_argument);
+    EXPECT_THROW(b.add("/a/{x}", 2), std::invalid_argument);  // same shape, different name
+    EXPECT_THROW(b.add("/a/x{id}", 0), std::invalid_argument);
+    EXPECT_THROW(b.add("/a/{}", 0), std::invalid_argument);
+    EXPECT_THROW(b.add("/a/{*rest}/b", 0), std::invalid_argument);
+    EXPECT_THROW(b.add("/{a}/{a}", 0), std::invalid_argument);
+    EXPECT_THROW(b.add("/{a}/{b}/{c}/{d}/{e}/{f}/{g}/{h}/{i}", 0), std::invalid_argument);
+    b.add("/a/{*rest}", 3);
+    EXPECT_THROW(b.add("/a/{*other}", 0), std::invalid_argument);
+
+    // building from an lvalue leaves the builder usable
+    auto r1 = b.build();
+    b.add("/b", 4);
+    auto r2 = b.build();
+    EXPECT_FALSE(r1.match("/b"));
+    EXPECT_EQ(*r2.match("/b").value, 4);
+    EXPECT_EQ(*r2.match("/a/1/2").value, 3);
+}
+
+TEST(UriRouterTest, ManyRoutesManyThreads) {
+    PathRouter<int>::Builder b;
+    for (int i = 0; i < 2000; ++i) b.add("/svc" + std::to_string(i) + "/items/{id}/v" + std::to_string(i % 7), i);
+    const auto r = std::move(b).build();
+
+    std::atomic<int>         bad{0};
+    std::vector<std::thread> ts;
+    for (int t = 0; t < 4; ++t) {
+        ts.emplace_back([&, t] {
+            for (int i = t; i < 2000; i += 4) {
+                std::string p = "/svc" + std::to_string(i) + "/items/x" + std::to_string(i) + "/v" + std::to_string(i % 7);
+                auto        m = r.match(p);
+                if (!m || *m.value != i || m.param("id") != "x" + std::to_string(i)) ++bad;
+                if (r.match("/svc" + std::to_string(i) + "/items/1/v9")) ++bad;
+            }
+        });
+    }
+    for (auto& t : ts) t.join();
+    EXPECT_EQ(bad, 0);
+}
@@ -0,0 +1,65 @@
+#include <string>
+#include <string_view>
+
+#include <gtest/gtest.h>
+#include "uri_stream.h"
+
+using cpptools::net::parse_mode;
+using cpptools::net::StreamOptions;
+using cpptools::net::uri_errc;
+using cpptools::net::URIStreamParser;
+
+TEST(UriStreamTest, EveryChunkingMatchesOneShotParse) {
+    const std::string in = "mongodb://u%40x:p@a:1,[::1]:2,b/db/x%20y?w=majority&r=%41#frag";
+    const auto        want = cpptools::net::URI(in, parse_mode::strict);
+    for (auto mode : {parse_mode::lenient, parse_mode::strict}) {
+        for (size_t step = 1; step <= in.size(); ++step) {
+            URIStreamParser p(StreamOptions{mode, 1024});
+            for (size_t at = 0; at < in.size(); at += step) ASSERT_FALSE(p.feed(std::string_view(in).substr(at, step)));
+            auto v = p.finish();
+            ASSERT_TRUE(v.has_value()) << step;
+            EXPECT_EQ(v->scheme(), "mongodb");
+            EXPECT_EQ(v->hosts().size(), 3);
+            EXPECT_EQ(v->raw_path(), "/db/x%20y");
+            EXPECT_EQ(v->raw_query(), "w=majority&r=%41");
+            EXPECT_EQ(v->fragment(), "frag");
+
+            auto u = p.take();
+            ASSERT_TRUE(u.has_value());
+            EXPECT_EQ(*u, want);
+            EXPECT_EQ(u->hosts()[1].host, "::1");
+            EXPECT_EQ(p.size(), 0);
+        }
+    }
+}
+
+TEST(UriStreamTest, StrictRejectsAsSoonAsTheBadByteArrives) {
+    URIStreamParser p(StreamOptions{parse_mode::strict});
+    EXPECT_FALSE(p.feed("http://exa"));
+    auto err = p.feed("mple.com/a b");
+    EXPECT_EQ(err.code, uri_errc::invalid_char);
+    EXPECT_EQ(err.offset, 20);
+    // errors are sticky until reset
+    EXPECT_EQ(p.feed("/more"), err);
+    EXPECT_FALSE(p.finish().has_value());
+
+    p.reset();
+    EXPECT_FALSE(p.feed("http://h/%4"));
+    EXPECT_EQ(p.finish().error().code, uri_errc::bad_percent_encoding);
+}
+
+TEST(UriStreamTest, MaxLength) {
+    URIStreamParser p(StreamOptions{parse_mode::lenient, 16});
+    EXPECT_FALSE(p.feed("http://host/"));
+    EXPECT_FALSE(p.feed("abcd"));
+    auto err = p.feed("e");
+    EXPECT_EQ(err.code, uri_errc::input_too_long);
+    EXPECT_EQ(err.offset, 16);
+    // the oversized chunk was never buffered
+    EXPECT_EQ(p.size(), 16);
+
+    p.reset();
+    EXPECT_EQ(p.finish().error().code, uri_errc::empty_input);
+    EXPECT_FALSE(p.feed("redis://h:6379"));
+    EXPECT_EQ(p.take()->hosts()[0].port, 6379);
+}